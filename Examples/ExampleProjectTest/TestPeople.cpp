@@ -3,8 +3,12 @@
 #include "ExampleProject/OldPerson.h"
 #include "ExampleProject/YoungPerson.h"
 
+#include <cstdlib>
+#include <iostream>
 #include <sstream>
 #include <memory>
+#include <stdexcept>
+#include <vector>
 
 DEFINE_TEST_FUNCTION
 (
@@ -38,6 +42,14 @@ DEFINE_TEST_FUNCTION
     assertEqual(peteString1, peteString2);
 )
 
+DEFINE_TEST_FUNCTION
+(
+    const Person testPersonPete("Pete", 24, 180.1F);
+
+    assertNear(testPersonPete.getWeight(), 180.1, 1e-4);
+    assertNearUlps(testPersonPete.getWeight(), 180.1F, 0);
+)
+
 DEFINE_TEST_FUNCTION
 (
     const OldPerson oldPersonPete("Pete", 400, 180.0F);
@@ -127,4 +139,205 @@ void testAssertionFailureAgeCompare()
     assertGreaterThan(youngPersonPete, oldPersonPete); // fails
 }
 
+// Shared by every test that names it; built once, before the first of them runs
+class Crowd : public TestRunner::Fixture
+{
+public:
+    Crowd()
+    {
+        for(unsigned short age = 0; age < 100; ++age)
+            people.push_back(Person("Pete", age, 80.0F));
+    }
+
+    void setUp()
+    {
+        visitor = Person("Joe", 13, 45.0F);
+    }
+
+    std::vector<Person> people;
+    Person visitor;
+};
+
+DEFINE_FIXTURE_TEST
+(
+    crowdIsOrderedByAge,
+    Crowd,
+    crowd,
+    for(size_t person = 1; person < crowd.people.size(); ++person)
+        assertLessThan(crowd.people[person - 1], crowd.people[person]);
+)
+
+DEFINE_FIXTURE_TEST
+(
+    visitorIsYoungerThanTheEldest,
+    Crowd,
+    crowd,
+    assertLessThan(crowd.visitor, crowd.people.back());
+    crowd.visitor.setAge(200);
+)
+
+DEFINE_FIXTURE_TEST
+(
+    crowdEndsWithTheEldest,
+    Crowd,
+    crowd,
+    assertNoThrow(crowd.people.at(99));
+    assertThrows(std::out_of_range, crowd.people.at(100));
+)
+
+class PersonMock : public Person
+{
+public:
+    MOCK_CONST_METHOD0(getName, std::string());
+    MOCK_CONST_METHOD0(getAge, unsigned short());
+    MOCK_CONST_METHOD0(getWeight, float());
+};
+
+DEFINE_NAMED_TEST_FUNCTION
+(
+    printingAsksForEveryField,
+    PersonMock pete;
+    expectCall(pete, getName).returns(std::string("Pete"));
+    expectCall(pete, getAge).returns(24);
+    expectCall(pete, getWeight).returns(180.0F);
+
+    std::ostringstream stringStream;
+    stringStream << pete;
+    assertEqual(stringStream.str(), std::string("Pete 24 180"));
+)
+
+void testMockAssertionFailure()
+{
+    PersonMock pete;
+    expectCall(pete, getAge).returns(24);
+    expectCall(pete, getAge).returns(30);
+
+    assertEqual(pete.getAge(), 24);
+    assertEqual(pete.getAge(), 30);
+    assertEqual(pete.getAge(), 24); // passes, both have their call and the first one answers
+} // fails, the first expectation was called twice
+
+REGISTER_TEST_FUNCTIONS(testMockAssertionFailure)
+
+namespace SlimTest
+{
+    template<>
+    struct Arbitrary<Person>
+    {
+        static void generate(Random& random, Person* people, size_t count)
+        {
+            for(size_t i = 0; i < count; ++i)
+                people[i] = Person(arbitrary<std::string>(random), (unsigned short)random.below(120), (float)(random.unit() * 200.0));
+        }
+
+        static void shrink(const Person& person, std::vector<Person>& candidates)
+        {
+            std::vector<std::string> names;
+            Arbitrary<std::string>::shrink(person.getName(), names);
+            for(auto&& name : names)
+                candidates.push_back(Person(name, person.getAge(), person.getWeight()));
+        }
+    };
+}
+
+DEFINE_PROPERTY_TEST
+(
+    personEqualsItsCopy,
+    Person,
+    person,
+    const Person copy(person.getName(), person.getAge(), person.getWeight());
+    assertEqual(person, copy);
+)
+
+static const unsigned short ages[] = { 0, 17, 18, 65, 119 };
+
+DEFINE_PARAMETERIZED_TEST
+(
+    personKeepsAge,
+    unsigned short,
+    age,
+    ages,
+    assertEqual(Person("Pete", age, 180.0F).getAge(), age);
+)
+
+DEFINE_FUZZ_TEST
+(
+    personPrintsAnyName,
+    data,
+    size,
+    const std::string name(reinterpret_cast<const char*>(data), size);
+    std::ostringstream stringStream;
+    stringStream << Person(name, 24, 180.0F);
+    assertEqual(stringStream.str(), name + " 24 180");
+)
+
+static const Person sharedPete("Pete", 24, 180.0F);
+
+DEFINE_STRESS_TEST
+(
+    personReadsFromManyThreads,
+    4,
+    10000,
+    thread,
+    assertEqual(sharedPete.getAge(), 24);
+    assertEqual(sharedPete.getName(), std::string("Pete"));
+)
+
+#ifndef SLIMTEST_WINDOWS
+// Checks its invariants the way production code does, by giving up on the process
+class CheckedPerson : public Person
+{
+public:
+    CheckedPerson(const std::string& name, unsigned short age, float weight)
+        : Person(name, age, weight)
+    {
+        verify();
+    }
+
+    void verify()
+    {
+        if(m_name.empty())
+            std::exit(2);
+        if(m_age > 150)
+        {
+            std::cerr << m_name << " is " << m_age << ", older than anyone" << std::endl;
+            std::abort();
+        }
+    }
+};
+
+DEFINE_NAMED_TEST_FUNCTION
+(
+    checkedPersonDiesOfOldAge,
+    CheckedPerson pete("Pete", 24, 180.0F);
+
+    assertDeath(pete.setAge(400), "Pete is [0-9]+, older than anyone");
+    assertDeath(CheckedPerson("Joe", 151, 80.0F), "older than anyone");
+    assertExit(pete.setName(""), 2);
+    assertEqual(pete.getAge(), 24);
+)
+
+void testDeathAssertionFailure()
+{
+    CheckedPerson pete("Pete", 24, 180.0F);
+
+    assertExit(CheckedPerson("", 24, 180.0F), 2); // passes
+    assertDeath(pete.setAge(30), "older than anyone"); // fails, the statement returned
+}
+
+REGISTER_TEST_FUNCTIONS(testDeathAssertionFailure)
+#endif
+
 REGISTER_TEST_FUNCTIONS(testOldPersonComparisonYoungPerson, testOldPeopleVerify, testYoungPeopleVerify, testEquality, testAssertionFailure, testAssertionFailureAgeCompare)
+
+DEFINE_BENCHMARK_FUNCTION
+(
+    personEquality,
+    const Person testPersonPete("Pete", 24, 180.0F);
+    const Person testPersonPeter("Peter", 24, 180.0F);
+
+    BENCHMARK_LOOP
+    {
+        SlimTest::doNotOptimize(testPersonPete == testPersonPeter);
+    }
+)
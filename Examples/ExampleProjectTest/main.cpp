@@ -1,4 +1,9 @@
 
+// Every example test is also checked for leaks. On Windows the people live in a DLL, whose
+// blocks would cross the replaced operators, so the tracker is left off there.
+#ifndef _WIN32
+    #define SLIMTEST_TRACK_LEAKS
+#endif
 #include "../../SlimTest.h"
 
 RUN_TESTS_MAIN("PersonTest")
@@ -24,168 +24,5914 @@
 
 #pragma once
 
-#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <regex>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <initializer_list>
 
+#if defined WIN32 || defined _WIN64 || defined _WIN32
+    #define SLIMTEST_WINDOWS
+    #include <direct.h>
+    #include <io.h>
+#else
+    #include <cerrno>
+    #include <csignal>
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <pthread.h>
+    #include <sys/resource.h>
+    #include <sys/stat.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#if defined __linux__ && (defined __GNUC__ || defined __clang__)
+    #define SLIMTEST_HAS_COVERAGE
+#endif
+
+#if defined __clang__
+    #define SLIMTEST_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined __GNUC__ && __GNUC__ >= 12
+    #define SLIMTEST_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+    #define SLIMTEST_NO_COVERAGE
+#endif
+
+// __declspec(thread) only holds plain data, nothing is destroyed when the thread exits
+#if defined _MSC_VER && _MSC_VER < 1900
+    #define SLIMTEST_THREAD_LOCAL __declspec(thread)
+#else
+    #define SLIMTEST_THREAD_LOCAL thread_local
+    #define SLIMTEST_THREAD_EXIT
+#endif
+
+#if defined __GNUC__ || defined __clang__
+    #define SLIMTEST_UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+    #define SLIMTEST_COLD __attribute__((cold, noinline))
+    #define SLIMTEST_NOINLINE __attribute__((noinline))
+    #define SLIMTEST_RETURN_ADDRESS __builtin_return_address(0)
+#elif defined _MSC_VER
+    #include <intrin.h>
+    #define SLIMTEST_UNLIKELY(condition) (condition)
+    #define SLIMTEST_COLD __declspec(noinline)
+    #define SLIMTEST_NOINLINE __declspec(noinline)
+    #define SLIMTEST_RETURN_ADDRESS _ReturnAddress()
+#else
+    #define SLIMTEST_UNLIKELY(condition) (condition)
+    #define SLIMTEST_COLD
+    #define SLIMTEST_NOINLINE
+    #define SLIMTEST_RETURN_ADDRESS nullptr
+#endif
+
 class TestRunner
 {
 public:
-    TestRunner(std::initializer_list<std::function<void ()>> functions);
     ~TestRunner(){}
 
     static int runTests(const std::string& name = "");
-    static void registerTests(std::initializer_list<std::function<void ()>> functions);
+    static int runTests(const std::string& name, int argc, char* argv[]);
+    static void registerTests(std::initializer_list<void (*)()> functions);
+    static void registerBenchmark(const char* name, void (*benchmark)(size_t));
     static void incrementAssertionCount();
     static void incrementFailedAssertions();
+    static void* allocate(size_t size);
+    static void deallocate(void* memory);
+    // allocate and deallocate behind a header that charges each block to the test that
+    // allocated it and catches bad deletes, see SLIMTEST_TRACK_LEAKS
+    static void* allocateTracked(size_t size, bool array, void* site);
+    static void deallocateTracked(void* memory, bool array, void* site);
+
+    // Describes one assertion site. Assertion macros keep these in constant-initialized
+    // statics, so a failure only has to capture the operand values.
+    struct Assertion
+    {
+        const char* file;
+        int line;
+        const char* expression;
+        const char* expectation;
+    };
+
+    struct Failure
+    {
+        const Assertion* assertion;
+        std::string values;
+    };
+
+    // Base class of the state DEFINE_FIXTURE_TEST shares between tests. A fixture is
+    // constructed when the first selected test using it runs and destroyed after the last
+    // one; setUp() and tearDown() run around each of those tests.
+    class Fixture
+    {
+    public:
+        virtual ~Fixture() {}
+        virtual void setUp() {}
+        virtual void tearDown() {}
+    };
+
+    // The instance of one fixture type. Tests using it run one at a time, even under --jobs.
+    struct FixtureSlot
+    {
+        explicit FixtureSlot(Fixture* (*create)()) : create(create), instance(nullptr), users(0) {}
+
+        Fixture* (*create)();
+        Fixture* instance;
+        size_t users;
+        std::mutex mutex;
+    };
+
+    template<typename Type>
+    static FixtureSlot& fixtureSlot();
+    template<typename Type>
+    static Type& fixture();
+
+    // One registering macro's test functions, or one benchmark. The macros define these as
+    // statics next to a constant array of function pointers; constructing one only links it
+    // into a list, and names and indices are worked out once the tests are run.
+    struct Registration
+    {
+        Registration(const char* names, const char* file, int line,
+            void (* const* functions)(), size_t count, FixtureSlot* fixture = nullptr);
+        Registration(const char* name, void (*benchmark)(size_t));
+        Registration(const char* name, unsigned timeout);
+
+        const char* names;
+        const char* file;
+        int line;
+        void (* const* functions)();
+        size_t count;
+        FixtureSlot* fixture;
+        void (*benchmark)(size_t);
+        unsigned timeout;
+        Registration* next;
+
+    private:
+        void link();
+        Registration(const Registration&);
+        Registration& operator=(const Registration&);
+    };
+
+    static void recordFailure(const Assertion& assertion, const std::string& values);
+    // Counts a reached assertion and remembers it as the last one its thread reached
+    static void incrementAssertionCount(const Assertion& assertion);
+    template<typename Lhs, typename Rhs>
+    SLIMTEST_COLD static void fail(const Assertion& assertion, const Lhs& lhs, const Rhs& rhs);
+    template<typename Value>
+    SLIMTEST_COLD static void fail(const Assertion& assertion, const Value& value);
+
+    // Runs property against --property-cases generated values, see DEFINE_PROPERTY_TEST. The
+    // first value it fails for is shrunk before being reported against assertion.
+    template<typename Value>
+    static void checkProperty(const Assertion& assertion, void (*property)(const Value&));
+    // Runs property against every element of values, see DEFINE_PARAMETERIZED_TEST
+    template<typename Value, typename Values>
+    static void checkParameters(const Assertion& assertion, const Values& values, void (*property)(const Value&));
+    // Runs target on every input saved for the fuzz test name, or fuzzes it when --fuzz
+    // selected it, see DEFINE_FUZZ_TEST
+    static void checkFuzzTarget(const Assertion& assertion, const char* name, void (*target)(const std::uint8_t*, size_t));
+    // Runs body iterations times on each of threads threads, released together by a spinning
+    // barrier, with the assertions they reach yielding and stalling at random, see
+    // DEFINE_STRESS_TEST
+    static void checkStress(const Assertion& assertion, size_t threads, size_t iterations, void (*body)(size_t));
+
+    // Compares count elements of two contiguous ranges in blocks that compile to vector code,
+    // reporting the number of mismatches and the first few, see assertArrayNear and
+    // assertSpanEqual
+    template<typename Lhs, typename Rhs, typename Tolerance>
+    static void checkArrayNear(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count, Tolerance tolerance);
+    template<typename Lhs, typename Rhs>
+    static void checkSpanEqual(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count);
+    // fail() with values printed to full precision, see assertNear
+    template<typename Lhs, typename Rhs>
+    SLIMTEST_COLD static void failNear(const Assertion& assertion, const Lhs& lhs, const Rhs& rhs);
+
+    // Fail assertion unless call throws an Exception, or unless it returns, see assertThrows
+    // and assertNoThrow
+    template<typename Exception, typename Call>
+    static void checkThrows(const Assertion& assertion, Call call);
+    template<typename Call>
+    static void checkNoThrow(const Assertion& assertion, Call call);
+    // Fail assertion unless statement, run in a forked child, takes the child down with what
+    // it wrote to stderr matching pattern. code is the exit status wanted, or null for any
+    // signal or nonzero status, see assertDeath and assertExit. A child still running once
+    // the test's budget is spent is killed.
+    template<typename Statement>
+    static void checkDeath(const Assertion& assertion, Statement statement, const char* pattern, const int* code);
+
+    struct Context;
+    static Context* currentTest();
+
+    // Attributes the assertions made on the thread it lives on to the test returned by
+    // currentTest() on the test's own thread. Only needed for threads spawned by tests
+    // running under --jobs; in a sequential run every thread counts towards the running test.
+    class ThreadScope
+    {
+    public:
+        explicit ThreadScope(Context* test);
+        ~ThreadScope();
+
+    private:
+        ThreadScope(const ThreadScope&);
+        ThreadScope& operator=(const ThreadScope&);
+
+        Context* previous;
+    };
+
+#ifdef SLIMTEST_HAS_COVERAGE
+    // Blocks reached by code built with -fsanitize-coverage, see SLIMTEST_COVERAGE. Every
+    // block gets a slot by hashing its address and reached marks the slots hit since the
+    // running test started. The hooks run before main and inside tests, so nothing they
+    // call is instrumented itself and the map is plain zero-initialized storage.
+    struct CoverageMap
+    {
+        enum { bits = 18, capacity = 1 << bits, probes = 64, tableCapacity = 64 };
+        static const std::uint32_t unslotted = 0xffffffffu;
+
+        std::uintptr_t blocks[capacity];
+        unsigned char reached[capacity];
+        // Every block of the modules built with pc-table, as begin and end of their tables
+        const std::uintptr_t* tables[tableCapacity][2];
+        std::uint32_t tableCount;
+        // Counts reached bytes going from 0 to 1, which --fuzz takes for new coverage
+        std::uint64_t growth;
+
+        SLIMTEST_NO_COVERAGE static std::uint32_t slot(std::uintptr_t block);
+        SLIMTEST_NO_COVERAGE static void reach(std::uintptr_t block);
+        SLIMTEST_NO_COVERAGE static void reachGuard(std::uint32_t* guard, std::uintptr_t block);
+        SLIMTEST_NO_COVERAGE static void initializeGuards(std::uint32_t* start, std::uint32_t* stop);
+        SLIMTEST_NO_COVERAGE static void addTable(const std::uintptr_t* begin, const std::uintptr_t* end);
+    };
+    SLIMTEST_NO_COVERAGE static CoverageMap& coverageMap();
+#endif
+
+    // Resources one test function consumed, times in milliseconds. CPU time covers the whole
+    // process in a sequential run and only the worker thread under --jobs; peak memory is
+    // always process wide.
+    struct Profile
+    {
+        Profile() : index(0), wallTime(0), cpuTime(0), memoryGrowth(0), allocations(0), allocatedBytes(0) {}
+
+        std::uint64_t index;
+        double wallTime;
+        double cpuTime;
+        std::int64_t memoryGrowth;
+        std::uint64_t allocations;
+        std::uint64_t allocatedBytes;
+    };
+
+    enum Status
+    {
+        Passed,
+        Failed,
+        Crashed,
+        TimedOut
+    };
+
+    // Everything reporters learn about one finished test function
+    struct TestResult
+    {
+        TestResult() : status(Passed), assertions(0) {}
+
+        std::string name;
+        Status status;
+        std::string detail;
+        size_t assertions;
+        std::vector<Failure> failures;
+        Profile profile;
+    };
+
+    // Receives results as test functions finish. Calls are serialized, so a reporter needs
+    // no locking of its own; it should write each result out rather than hold on to it.
+    class Reporter
+    {
+    public:
+        virtual ~Reporter() {}
+        virtual void runStarting(const std::string& name, size_t total) { (void)name; (void)total; }
+        virtual void testFinished(const TestResult& result) = 0;
+        virtual void runFinished(size_t passed, size_t total) { (void)passed; (void)total; }
+    };
+
+    static void addReporter(Reporter* reporter);
 
 private:
-    int internalRunTests(const std::string& name);
-    void internalRegisterTests(std::initializer_list<std::function<void ()>> functions);
-    void internalIncrementAssertionCount();
-    void internalIncrementFailedAssertions();
+    TestRunner();
+
+    struct Options
+    {
+        Options() : jobs(1), processes(0), timeout(0), benchmark(false), benchmarkSamples(100),
+            benchmarkTime(500), benchmarkAlpha(0.01), benchmarkThreshold(5.0), profile(0), list(false),
+            propertyCases(10000), propertySeed(0), changed(false), order("registration"), failFast(0),
+            shuffle(false), shuffleSeed(0), repeat(1), untilFail(false),
+            leakSites(false), fuzzTime(60.0), fuzzMaxLength(4096), corpus("SlimTest.corpus") {}
+
+        struct ReporterOutput
+        {
+            std::string format;
+            std::string path;
+        };
+
+        size_t jobs;
+        size_t processes;
+        unsigned timeout;
+        bool benchmark;
+        size_t benchmarkSamples;
+        unsigned benchmarkTime;
+        std::string benchmarkSave;
+        std::string benchmarkCompare;
+        double benchmarkAlpha;
+        double benchmarkThreshold;
+        size_t profile;
+        std::vector<ReporterOutput> reporters;
+        std::vector<std::string> includes;
+        std::vector<std::string> excludes;
+        bool list;
+        size_t propertyCases;
+        std::uint64_t propertySeed;
+        std::string state;
+        bool changed;
+        std::string order;
+        size_t failFast;
+        bool shuffle;
+        std::uint64_t shuffleSeed;
+        size_t repeat;
+        bool untilFail;
+        bool leakSites;
+        std::string coverage;
+        std::vector<std::string> coverageSources;
+        std::string fuzz;
+        double fuzzTime;
+        size_t fuzzMaxLength;
+        std::string corpus;
+    };
+
+    // What --fuzz hands the fuzz tests it selected
+    struct FuzzSession
+    {
+        double duration;
+        size_t maxLength;
+        std::uint64_t seed;
+        size_t workers;
+        size_t fuzzed;
+    };
+
+    // One thread of a stress test, random drives the perturbations at its assertions
+    struct StressThread
+    {
+        std::uint64_t random;
+        size_t iterations;
+        double seconds;
+        bool failed;
+        std::string thrown;
+    };
+
+    // Where a fuzz worker saves the input it was running should it crash. Kept in plain
+    // storage the signal handler can read.
+    struct FuzzCrash
+    {
+        char directory[4096];
+        const char* replaying;
+        const std::uint8_t* data;
+        size_t size;
+        int report;
+    };
+
+    // A registered test function together with where it was registered
+    struct TestCase
+    {
+        std::string name;
+        const char* file;
+        int line;
+        void (*function)();
+        FixtureSlot* fixture;
+        unsigned timeout;
+        // Reported against when an exception escapes the test function
+        Assertion thrown;
+        // Reported against when SLIMTEST_TRACK_LEAKS finds blocks it left allocated or bad deletes
+        Assertion leaked;
+    };
+
+    class ConsoleReporter;
+    class JUnitReporter;
+    class JsonLinesReporter;
+
+    typedef std::map<std::string, std::vector<double>> BenchmarkSamples;
+
+    // What --state remembers between runs: a content hash of every source file that registers
+    // tests, and how each test did the last time it ran
+    struct TestHistory
+    {
+        bool failed;
+        double wallTime;
+    };
+
+    struct RunState
+    {
+        std::map<std::string, std::uint64_t> files;
+        std::map<std::string, TestHistory> tests;
+    };
+
+    // The --state file of the run in progress and the hashes of the test files it records
+    struct StateFile
+    {
+        std::string path;
+        RunState state;
+        std::map<std::string, std::uint64_t> hashes;
+    };
+
+    // A benchmark body is handed the number of iterations to run in one timed sample
+    struct Benchmark
+    {
+        std::string name;
+        void (*function)(size_t);
+    };
+
+    enum ThreadStatus
+    {
+        ThreadActive,
+        ThreadRetired,
+        ThreadFree
+    };
+
+    // Assertion counts and failures of a single thread. The thread itself is the only writer,
+    // so counting is a relaxed load and store with no lock and no shared cache line. Blocks are
+    // never freed; once their thread exits and their counts are collected they are recycled.
+    struct BlockHeader;
+
+    // Blocks charged to the test a runner thread is running and not freed yet, and deletes
+    // of blocks that were not live. Lives in the runner's ThreadState, which is never freed,
+    // so a block outliving its test can still be handed back; the epoch moves on with every
+    // test and such late frees are ignored.
+    struct Ledger
+    {
+        Ledger() : epoch(0), blocks(0), bytes(0), ownerBlocks(0), ownerBytes(0), misuses(0), misuseSite(nullptr),
+            live(nullptr) {}
+
+        std::atomic<std::uint64_t> epoch;
+        std::atomic<size_t> blocks;
+        std::atomic<size_t> bytes;
+        // Counted apart and without locked instructions by the thread the ledger belongs to
+        std::atomic<size_t> ownerBlocks;
+        std::atomic<size_t> ownerBytes;
+        std::atomic<size_t> misuses;
+        std::atomic<void*> misuseSite;
+        // The live blocks themselves, only linked with --leak-sites
+        std::mutex mutex;
+        BlockHeader* live;
+    };
+
+    // What the block table knows about live scalar and array blocks, and about freed ones
+    enum BlockTag : std::uint64_t
+    {
+        LiveBlock = 0x51696d546573744eULL,
+        LiveArray = 0x51696d5465737441ULL,
+        FreedBlock = 0x51696d5465737446ULL
+    };
+
+    // Precedes every block allocateTracked hands out. Only read once the block table says the
+    // block is ours.
+    struct BlockHeader
+    {
+        size_t size;
+        Ledger* ledger;
+        std::uint64_t epoch;
+        void* site;
+        BlockHeader* previous;
+        BlockHeader* next;
+    };
+
+    // BlockHeader rounded up so the block after it keeps the alignment malloc gave
+    static const size_t blockOffset = (sizeof(BlockHeader) + 15) / 16 * 16;
+
+    // The tags of the blocks allocateTracked handed out by header address, so a delete tells
+    // ours from foreign pointers without reading the memory in front of them. A freed block
+    // keeps its entry until malloc hands the address out again, which is what catches the
+    // second delete. Sharded by address; each shard is an open addressing table in malloc'd
+    // memory, so the table never calls back into operator new.
+    class BlockTable
+    {
+    public:
+        bool record(std::uintptr_t header, std::uint64_t tag);
+        std::uint64_t release(std::uintptr_t header);
+        void lockAll();
+        void unlockAll();
+
+    private:
+        struct Entry
+        {
+            std::uintptr_t header;
+            std::uint64_t tag;
+        };
+
+        struct Shard
+        {
+            Shard() : entries(nullptr), capacity(0), used(0) {}
+
+            std::mutex mutex;
+            Entry* entries;
+            size_t capacity;
+            size_t used;
+        };
+
+        static const size_t shardCount = 64;
+
+        static std::uint64_t hash(std::uintptr_t header);
+        static Entry& find(const Shard& shard, std::uintptr_t header, std::uint64_t hashed);
+        static bool grow(Shard& shard);
+
+        Shard shards[shardCount];
+    };
+
+    struct ThreadState
+    {
+        ThreadState() : totalAssertions(0), failedAssertions(0), allocations(0), allocatedBytes(0),
+            lastAssertion(nullptr), owner(nullptr), status(ThreadActive), collectedTotal(0), collectedFailed(0),
+            collectedAllocations(0), collectedBytes(0), charged(nullptr), executing(nullptr), stressing(nullptr), next(nullptr) {}
+
+        std::atomic<size_t> totalAssertions;
+        std::atomic<size_t> failedAssertions;
+        std::atomic<size_t> allocations;
+        std::atomic<size_t> allocatedBytes;
+        std::atomic<const Assertion*> lastAssertion;
+        std::atomic<Context*> owner;
+        std::atomic<int> status;
+        size_t collectedTotal;
+        size_t collectedFailed;
+        size_t collectedAllocations;
+        size_t collectedBytes;
+        // Appended to by the owning thread, folded away by whichever thread collects
+        std::mutex failuresMutex;
+        std::vector<Failure> failures;
+        // Used while this thread runs tests; charged points at the ledger of whichever test
+        // the thread's allocations count against, if any
+        Ledger ledger;
+        Ledger* charged;
+        // The test this thread executes as a runner thread, bound to it or not
+        Context* executing;
+        // Set while the thread runs a stress test's body
+        StressThread* stressing;
+        ThreadState* next;
+    };
+
+    // Failure counts of the calling thread, taken so a probe that fails can be undone
+    struct Checkpoint
+    {
+        size_t failed;
+        size_t failures;
+    };
+
+    struct ThreadStateRelease
+    {
+        ~ThreadStateRelease();
+    };
+
+    // One double ended queue of test indices per worker. Owners pop from the back,
+    // idle workers steal from the front of somebody else's queue.
+    class WorkQueue
+    {
+    public:
+        void push(size_t index);
+        bool pop(size_t& index);
+        bool steal(size_t& index);
+
+    private:
+        std::mutex mutex;
+        std::deque<size_t> indices;
+    };
+
+#ifndef SLIMTEST_WINDOWS
+    // A forked child process that runs whichever test indices it is sent over a pipe
+    struct Worker
+    {
+        Worker() : pid(-1), toChild(-1), fromChild(-1), index(0), busy(false) {}
+
+        pid_t pid;
+        int toChild;
+        int fromChild;
+        size_t index;
+        bool busy;
+        std::chrono::steady_clock::time_point started;
+        std::string received;
+    };
+
+    // Sent back by a worker process once a test finishes, followed by detail bytes of
+    // TestResult::detail and length bytes of failures. A forked worker shares the parent's
+    // image, so Assertion pointers stay valid.
+    struct WorkerResult
+    {
+        std::uint64_t index;
+        std::uint64_t status;
+        std::uint64_t assertions;
+        std::uint64_t detail;
+        std::uint64_t length;
+        Profile profile;
+    };
+#endif
+
+    // Ends a test that runs past its time budget, see --timeout and SET_TEST_TIMEOUT. Runner
+    // threads publish the deadline of the test they are executing in their Context.
+    class Watchdog
+    {
+    public:
+        Watchdog();
+        ~Watchdog();
+
+        void watch(Context& context);
+        void unwatch(Context& context);
+
+    private:
+        Watchdog(const Watchdog&);
+        Watchdog& operator=(const Watchdog&);
+        void run();
+
+        std::vector<Context*> contexts;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+        std::thread thread;
+    };
+
+    // Carries the console output of a test run to a background writer, so runner threads
+    // never wait on a slow terminal or pipe. While it runs std::cout posts into the same
+    // ring, so what tests print keeps its place among the reports. Messages are written in
+    // the order they were posted. The writer collects them in a buffer of its own and hands
+    // that to the stream only when it fills up, when flush() asks and at the end of the run.
+    class OutputSink
+    {
+    public:
+        OutputSink();
+        ~OutputSink();
+
+        void post(std::string* text);
+        void flush();
+        void abandon();
+#ifndef SLIMTEST_WINDOWS
+        void salvage() const;
+#endif
+
+    private:
+        OutputSink(const OutputSink&);
+        OutputSink& operator=(const OutputSink&);
+        bool pop(std::string*& text);
+        bool pending() const;
+        void stage(const std::string& text);
+        void handOver();
+        void run();
+
+        // Stands in for the buffer of std::cout, every write becomes a message of its own
+        class Capture : public std::streambuf
+        {
+        protected:
+            int_type overflow(int_type character);
+            std::streamsize xsputn(const char* text, std::streamsize size);
+        };
+
+        static const size_t capacity = 1024;
+        static const size_t stagingSize = 65536;
+
+        // A bounded multi producer ring, each cell's sequence tells whose turn it is
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            std::string* text;
+        };
+
+        Cell cells[capacity];
+        std::atomic<size_t> enqueued;
+        std::atomic<size_t> dequeued;
+        size_t requested;
+        std::atomic<size_t> flushed;
+        char staging[stagingSize];
+        std::atomic<size_t> staged;
+        Capture capture;
+        std::streambuf* stream;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable drained;
+        bool stopping;
+        std::thread thread;
+    };
+
+    int internalRunTests(const std::string& name, const Options& options);
+    size_t runBenchmarks(const Options& options);
+    std::vector<double> measure(const Benchmark& benchmark, const Options& options);
+    static bool loadBenchmarkSamples(const std::string& path, BenchmarkSamples& samples);
+    static bool saveBenchmarkSamples(const std::string& path, const BenchmarkSamples& samples);
+    // Layout of the state file. Files without a version line come from before test lines
+    // recorded the wall time.
+    static const int stateVersion = 2;
+    static bool loadState(const std::string& path, RunState& state);
+    static bool saveState(const std::string& path, const RunState& state);
+    static bool hashFile(const char* path, std::uint64_t& hash);
+    std::vector<size_t> changedTests(const RunState& state, const std::map<std::string, std::uint64_t>& hashes) const;
+    void updateState(RunState& state, const std::map<std::string, std::uint64_t>& hashes) const;
+    void saveRunState();
+    void orderTests(const RunState& state, const std::string& order);
+    std::vector<size_t> longestFirst() const;
+    bool stopped() const;
+    void shuffleTests(std::uint64_t seed);
+    void countFixtureUsers();
+    static double mannWhitneyPValue(const std::vector<double>& baseline, const std::vector<double>& current);
+    size_t runSequential();
+    size_t runParallel(size_t jobs);
+    bool runTest(size_t index, Context& context);
+    void executeTest(size_t index, Context& context);
+#ifndef SLIMTEST_WINDOWS
+    size_t runIsolated(size_t processes);
+    bool spawnWorker(Worker& worker);
+    void serveWorker(int input, int output);
+    void stopWorker(Worker& worker);
+    static bool readAll(int descriptor, void* buffer, size_t size);
+    static bool writeAll(int descriptor, const void* buffer, size_t size);
+    static void readUntilClosed(int descriptor, std::string& text);
+#endif
+    void report(const std::string& text);
+    static void output(std::string text);
+#ifndef SLIMTEST_WINDOWS
+    static void crashed(int number);
+#endif
+    void finish(const TestResult& result);
+    void finishUnbound(const TestResult& result);
+    void reportProfiles();
+#ifdef SLIMTEST_HAS_COVERAGE
+    struct SourceLine
+    {
+        std::string file;
+        int line;
+    };
+
+    void harvestCoverage(size_t index);
+    bool writeCoverage(const std::string& path, const std::string& name, const std::vector<std::string>& sources) const;
+    static bool coveredSource(const std::string& file, const std::vector<std::string>& sources);
+    static void symbolize(const std::vector<std::uintptr_t>& addresses, std::map<std::uintptr_t, SourceLine>& lines);
+    static std::string lcovName(const std::string& name);
+#endif
+    const std::string& testName(size_t index) const;
+    std::vector<size_t> select(const Options& options) const;
+    static bool selected(const std::string& name, const Options& options);
+    static bool matchGlob(const char* pattern, const char* text);
+    static void formatFailures(std::ostream& stream, const std::vector<Failure>& failures);
+    static std::string escapeXml(const std::string& text);
+    static std::string escapeJson(const std::string& text);
+    static double cpuTime(bool process);
+    static std::int64_t peakMemory();
+    void discover();
+    void discoverTests(const Registration& registration);
+    static Registration*& registrations();
+    static Registration*& lastRegistration();
+    static bool parseArguments(int argc, char* argv[], Options& options);
+    static Checkpoint checkpoint();
+    static bool failedSince(const Checkpoint& checkpoint);
+    static void rollback(const Checkpoint& checkpoint);
+    static std::atomic<bool>& leakSites();
+    static void replayCorpus(const Assertion& assertion, const char* name, void (*target)(const std::uint8_t*, size_t));
+    static void fuzz(const Assertion& assertion, const char* name, void (*target)(const std::uint8_t*, size_t));
+    static bool fuzzWorker(const Assertion& assertion, void (*target)(const std::uint8_t*, size_t),
+        const std::string& directory, size_t worker, int report);
+    static bool runFuzzInput(void (*target)(const std::uint8_t*, size_t), const std::vector<std::uint8_t>& input,
+        std::string& thrown);
+    static FuzzCrash& fuzzCrash();
+    static void catchFuzzCrashes(bool catching);
+    static void perturb(StressThread& thread);
+#ifndef SLIMTEST_WINDOWS
+    static void fuzzCrashed(int number);
+#endif
+    static std::uint64_t inputHash(const std::uint8_t* data, size_t size);
+    static std::string inputName(const std::vector<std::uint8_t>& input);
+    static bool listDirectory(const std::string& path, std::vector<std::string>& names);
+    static void makeDirectory(const std::string& path);
+    static bool readInput(const std::string& path, std::vector<std::uint8_t>& input);
+    static bool saveInput(const std::string& path, const std::vector<std::uint8_t>& input);
+    static std::uint64_t coverageGrowth();
+    static void charge(Ledger& ledger, bool owner, size_t blocks, size_t bytes);
+    static void misusedBlock(void* site);
+    static BlockTable& blockTable();
+    static void openLedger(Ledger& ledger);
+    static void closeLedger(const TestCase& test, Ledger& ledger);
+    template<typename Value>
+    static bool probe(void (*property)(const Value&), const Value& value);
+    template<typename Lhs, typename Rhs, typename Matches>
+    static void checkSpan(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count, Matches matches);
+    template<typename Call>
+    bool guard(const TestCase& test, Call call);
+    static std::string describeException();
+#ifndef SLIMTEST_WINDOWS
+    static unsigned deathBudget();
+    static pid_t forkDeathTest(int& errors, int& returned);
+    static void awaitDeath(const Assertion& assertion, pid_t child, int errors, int returned, const char* pattern,
+        const int* code);
+#endif
+    static void collect(Context& context);
+    static void fold(ThreadState& state, Context& context);
+    static ThreadState& threadState();
+    static ThreadState*& threadStateSlot();
+    static ThreadState* acquireThreadState();
+    static std::atomic<ThreadState*>& threadStates();
+    static std::mutex& collectMutex();
     static TestRunner& testRunner();
+    template<typename Type>
+    static Fixture* createFixture();
+    void releaseFixtures();
+    unsigned testTimeout(size_t index) const;
+    static std::int64_t steadyMilliseconds();
+    void timedOut(Context& context);
+
+    std::vector<TestCase> testCases;
+    std::unordered_map<std::string, size_t> testIndex;
+    std::vector<size_t> selection;
+    std::vector<Benchmark> benchmarks;
+    const Registration* discovered;
+    std::vector<Profile> profiles;
+    size_t profileLimit;
+    size_t propertyCases;
+    std::uint64_t propertySeed;
+    size_t propertyThreads;
+    std::unordered_map<std::string, unsigned> timeouts;
+    unsigned defaultTimeout;
+    Watchdog* watchdog;
+    OutputSink* sink;
+    int workerOutput;
+    std::mutex outputMutex;
+    std::atomic<size_t> finishedTests;
+    std::atomic<size_t> failedTests;
+    size_t failLimit;
+    bool balance;
+    // Per test: -1 if it did not run, otherwise whether it failed, and how long it took
+    std::vector<signed char> outcomes;
+    std::vector<double> wallTimes;
+    // Per test: how long it took last time according to --state, or -1
+    std::vector<double> expectedTimes;
+    // The corpus directory DEFINE_FUZZ_TEST reads, and the --fuzz run if one is going on
+    std::string corpus;
+    FuzzSession* fuzzing;
+    StateFile* stateFile;
+    // Test functions started so far, over every iteration
+    size_t startedRuns;
+    // Per test: the sorted CoverageMap slots it reached, with --coverage
+    bool covering;
+    std::vector<std::vector<std::uint32_t>> coveredSlots;
+    std::vector<std::unique_ptr<Reporter>> reporters;
+    std::vector<Reporter*> activeReporters;
+    std::mutex reportMutex;
+};
+
+// Assertion totals of the test a runner thread is executing, collected from every thread
+// that asserted on its behalf. A sole context also collects threads bound to no test.
+struct TestRunner::Context
+{
+    Context(bool sole = false) : failedAssertions(0), totalAssertions(0), sole(sole), running(0),
+        budget(0), deadline(0), runner(nullptr) {}
+
+    size_t failedAssertions;
+    size_t totalAssertions;
+    bool sole;
+    Profile profile;
+    std::vector<Failure> failures;
+
+    // What the watchdog needs to know about the test being executed. deadline is 0 while no
+    // budget applies and -1 once the watchdog has claimed the test.
+    size_t running;
+    unsigned budget;
+    std::atomic<std::int64_t> deadline;
+    ThreadState* runner;
+
+    void reset();
+};
+
+// The human readable output SlimTest has always printed
+class TestRunner::ConsoleReporter : public TestRunner::Reporter
+{
+public:
+    void runStarting(const std::string& name, size_t total)
+    {
+        (void)total;
+        runName = name;
+    }
+
+    void testFinished(const TestResult& result)
+    {
+        if(result.status == Passed)
+            return;
+
+        std::ostringstream text;
+        formatFailures(text, result.failures);
+        text << "Test Function ";
+        switch(result.status)
+        {
+        case Crashed: text << "CRASHED (" << result.detail << ")"; break;
+        case TimedOut: text << "TIMED OUT " << result.detail; break;
+        default: text << "FAILED"; break;
+        }
+        text << " in " << result.name << "\n\n";
+        output(text.str());
+    }
+
+    void runFinished(size_t passed, size_t total)
+    {
+        std::ostringstream text;
+        text << passed << " tests passed out of " << total << " tests in " << runName << ".\n";
+        output(text.str());
+    }
+
+private:
+    std::string runName;
+};
+
+// Streams one <testcase> per finished test, so the file is usable while the run goes on
+class TestRunner::JUnitReporter : public TestRunner::Reporter
+{
+public:
+    explicit JUnitReporter(const std::string& path) : file(path.c_str())
+    {
+        file << std::fixed << std::setprecision(6);
+    }
+
+    void runStarting(const std::string& name, size_t total)
+    {
+        suite = escapeXml(name);
+        file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<testsuite name=\"" << suite << "\" tests=\"" << total << "\">\n" << std::flush;
+    }
+
+    void testFinished(const TestResult& result)
+    {
+        file << "  <testcase classname=\"" << suite << "\" name=\"" << escapeXml(result.name)
+            << "\" assertions=\"" << result.assertions << "\" time=\"" << result.profile.wallTime / 1000 << "\"";
+        if(result.status == Passed)
+        {
+            file << "/>\n" << std::flush;
+            return;
+        }
+
+        file << ">\n";
+        if(result.status != Failed)
+        {
+            file << "    <error type=\"" << (result.status == Crashed ? "crash" : "timeout")
+                << "\" message=\"" << escapeXml(result.detail) << "\"/>\n";
+        }
+        for(auto&& failure : result.failures)
+        {
+            const Assertion& assertion = *failure.assertion;
+            std::ostringstream message;
+            message << "Expected " << assertion.expectation;
+            if(!failure.values.empty())
+                message << " (" << failure.values << ")";
+            file << "    <failure type=\"assertion\" message=\"" << escapeXml(assertion.expression)
+                << "\">" << escapeXml(message.str()) << "\n    At: " << escapeXml(assertion.file)
+                << " " << assertion.line << "</failure>\n";
+        }
+        file << "  </testcase>\n" << std::flush;
+    }
+
+    void runFinished(size_t passed, size_t total)
+    {
+        (void)passed;
+        (void)total;
+        file << "</testsuite>\n" << std::flush;
+    }
+
+private:
+    std::ofstream file;
+    std::string suite;
+};
+
+// One JSON object per line and per finished test, bracketed by a run and a summary record
+class TestRunner::JsonLinesReporter : public TestRunner::Reporter
+{
+public:
+    explicit JsonLinesReporter(const std::string& path) : file(path.c_str()) {}
+
+    void runStarting(const std::string& name, size_t total)
+    {
+        file << "{\"type\":\"run\",\"name\":\"" << escapeJson(name) << "\",\"tests\":" << total << "}\n"
+            << std::flush;
+    }
+
+    void testFinished(const TestResult& result)
+    {
+        static const char* const statuses[] = { "passed", "failed", "crashed", "timed out" };
+        file << "{\"type\":\"test\",\"name\":\"" << escapeJson(result.name) << "\",\"status\":\""
+            << statuses[result.status] << "\",\"detail\":\"" << escapeJson(result.detail)
+            << "\",\"assertions\":" << result.assertions
+            << ",\"wall_ms\":" << result.profile.wallTime << ",\"cpu_ms\":" << result.profile.cpuTime
+            << ",\"failures\":[";
+        for(size_t i = 0; i < result.failures.size(); ++i)
+        {
+            const Assertion& assertion = *result.failures[i].assertion;
+            file << (i ? "," : "") << "{\"expression\":\"" << escapeJson(assertion.expression)
+                << "\",\"expected\":\"" << escapeJson(assertion.expectation)
+                << "\",\"values\":\"" << escapeJson(result.failures[i].values)
+                << "\",\"file\":\"" << escapeJson(assertion.file) << "\",\"line\":" << assertion.line << "}";
+        }
+        file << "]}\n" << std::flush;
+    }
+
+    void runFinished(size_t passed, size_t total)
+    {
+        file << "{\"type\":\"summary\",\"passed\":" << passed << ",\"tests\":" << total << "}\n"
+            << std::flush;
+    }
+
+private:
+    std::ofstream file;
+};
+
+inline TestRunner::TestRunner()
+    : discovered(nullptr)
+    , profileLimit(0)
+    , propertyCases(0)
+    , propertySeed(0)
+    , propertyThreads(1)
+    , defaultTimeout(0)
+    , watchdog(nullptr)
+    , sink(nullptr)
+    , workerOutput(-1)
+    , finishedTests(0)
+    , failedTests(0)
+    , failLimit(0)
+    , balance(false)
+    , fuzzing(nullptr)
+    , stateFile(nullptr)
+    , startedRuns(0)
+    , covering(false)
+{
+}
+
+inline int TestRunner::runTests(const std::string& name)
+{
+    return testRunner().internalRunTests(name, Options());
+}
+
+inline int TestRunner::runTests(const std::string& name, int argc, char* argv[])
+{
+    Options options;
+    if(!parseArguments(argc, argv, options))
+        return -1;
+    return testRunner().internalRunTests(name, options);
+}
+
+inline int TestRunner::internalRunTests(const std::string& name, const Options& options)
+{
+    discover();
+    if(options.benchmark)
+        return (int)runBenchmarks(options);
+    leakSites().store(options.leakSites, std::memory_order_relaxed);
+
+    selection = select(options);
+    corpus = options.corpus;
+    if(!options.fuzz.empty())
+    {
+        std::vector<size_t> matching;
+        for(auto&& index : selection)
+            if(matchGlob(options.fuzz.c_str(), testCases[index].name.c_str()))
+                matching.push_back(index);
+        selection.swap(matching);
+    }
+
+    const bool history = options.changed || options.order != "registration";
+    StateFile persisted;
+    persisted.path = (history && options.state.empty()) ? "SlimTest.state" : options.state;
+    RunState& state = persisted.state;
+    std::map<std::string, std::uint64_t>& hashes = persisted.hashes;
+    expectedTimes.assign(testCases.size(), -1.0);
+    if(!persisted.path.empty())
+    {
+        loadState(persisted.path, state);
+        for(auto&& test : testCases)
+        {
+            std::uint64_t hash;
+            if(!hashes.count(test.file) && hashFile(test.file, hash))
+                hashes[test.file] = hash;
+        }
+        for(size_t index = 0; index < testCases.size(); ++index)
+        {
+            std::map<std::string, TestHistory>::const_iterator test = state.tests.find(testCases[index].name);
+            if(test != state.tests.end())
+                expectedTimes[index] = test->second.wallTime;
+        }
+        if(options.changed)
+            selection = changedTests(state, hashes);
+        orderTests(state, options.order);
+    }
+    balance = !persisted.path.empty() && !history && !options.shuffle;
+
+    const std::vector<size_t> ordered = selection;
+    const std::uint64_t shuffleSeed = options.shuffleSeed ? options.shuffleSeed
+        : (std::uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if(options.shuffle)
+        shuffleTests(shuffleSeed);
+    if(options.list)
+    {
+        for(auto&& index : selection)
+        {
+            const TestCase& test = testCases[index];
+            std::cout << test.name << " (" << test.file << " " << test.line << ")\n";
+        }
+        std::cout << std::flush;
+        return 0;
+    }
+
+    const size_t total = selection.size();
+    // --fuzz spreads every fuzz test over --jobs processes instead
+    const size_t jobs = !options.fuzz.empty() ? 1 : (total < options.jobs) ? total : options.jobs;
+    size_t failed = 0;
+    profileLimit = options.profile;
+    propertyCases = options.propertyCases;
+    propertySeed = options.propertySeed ? options.propertySeed
+        : (std::uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    // Property checks only spread over the cores when nothing else does
+    propertyThreads = (jobs > 1 || options.processes) ? 1 : std::thread::hardware_concurrency();
+    defaultTimeout = options.timeout;
+    finishedTests = 0;
+    failedTests = 0;
+    failLimit = options.failFast;
+    outcomes.assign(testCases.size(), -1);
+    wallTimes.assign(testCases.size(), 0.0);
+    profiles.clear();
+#ifdef SLIMTEST_HAS_COVERAGE
+    covering = !options.coverage.empty();
+    coveredSlots.assign(covering ? testCases.size() : 0, std::vector<std::uint32_t>());
+#endif
+
+    std::vector<std::unique_ptr<Reporter>> outputs;
+    outputs.push_back(std::unique_ptr<Reporter>(new ConsoleReporter()));
+    for(auto&& output : options.reporters)
+    {
+        if(output.format == "junit")
+            outputs.push_back(std::unique_ptr<Reporter>(new JUnitReporter(output.path)));
+        else
+            outputs.push_back(std::unique_ptr<Reporter>(new JsonLinesReporter(output.path)));
+    }
+    activeReporters.clear();
+    for(auto&& reporter : outputs)
+        activeReporters.push_back(reporter.get());
+    for(auto&& reporter : reporters)
+        activeReporters.push_back(reporter.get());
+
+    std::unique_ptr<OutputSink> writing(new OutputSink());
+    sink = writing.get();
+#ifndef SLIMTEST_WINDOWS
+    // Get out what the tests reported so far should one of them take the process down,
+    // isolated workers crash on their own
+    const int fatal[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS };
+    const size_t guarded = (options.processes == 0) ? sizeof(fatal) / sizeof(fatal[0]) : 0;
+    void (*previousHandlers[sizeof(fatal) / sizeof(fatal[0])])(int);
+    for(size_t i = 0; i < guarded; ++i)
+        previousHandlers[i] = std::signal(fatal[i], crashed);
+#endif
+    for(auto&& reporter : activeReporters)
+        reporter->runStarting(name, total);
+
+    // Isolated workers start their own watchdog
+    bool timed = false;
+    for(auto&& index : selection)
+        timed = timed || testTimeout(index) > 0;
+    std::unique_ptr<Watchdog> watching((timed && options.processes == 0) ? new Watchdog() : nullptr);
+    watchdog = watching.get();
+
+    FuzzSession session = { options.fuzzTime, options.fuzzMaxLength, propertySeed, options.jobs, 0 };
+    fuzzing = options.fuzz.empty() ? nullptr : &session;
+    stateFile = persisted.path.empty() ? nullptr : &persisted;
+    startedRuns = 0;
+
+    // --until-fail without --repeat goes on until something fails
+    const bool repeating = options.repeat > 1 || options.untilFail;
+    const size_t iterations = (options.untilFail && options.repeat <= 1) ? (size_t)-1 : options.repeat;
+    size_t iteration = 0;
+    while(iteration < iterations && !stopped())
+    {
+        // Every iteration gets its own seed, so a failing one can be rerun on its own
+        const std::uint64_t seed = shuffleSeed + iteration;
+        if(options.shuffle && iteration > 0)
+        {
+            selection = ordered;
+            shuffleTests(seed);
+        }
+        countFixtureUsers();
+        ++iteration;
+        startedRuns = total * iteration;
+
+        size_t failedNow;
+#ifndef SLIMTEST_WINDOWS
+        if(options.processes > 0)
+            failedNow = runIsolated((total < options.processes) ? total : options.processes);
+        else
+#endif
+        failedNow = (jobs > 1) ? runParallel(jobs) : runSequential();
+        releaseFixtures();
+        failed += failedNow;
+
+        if(failedNow > 0 && repeating)
+        {
+            std::ostringstream text;
+            text << "Iteration " << iteration << " FAILED";
+            if(options.shuffle)
+                text << " (--shuffle=" << seed << ")";
+            text << "\n\n";
+            report(text.str());
+            if(options.untilFail)
+                break;
+        }
+    }
+    watching.reset();
+    watchdog = nullptr;
+    if(fuzzing && session.fuzzed == 0)
+        report("No fuzz test matches --fuzz=" + options.fuzz + ".\n");
+    fuzzing = nullptr;
+
+    const size_t runs = total * iteration;
+    if(stopped() && finishedTests < runs)
+    {
+        std::ostringstream text;
+        text << "Stopped after " << failedTests << " failed tests, " << runs - finishedTests
+            << " tests did not run.\n\n";
+        report(text.str());
+    }
+    if(repeating && !stopped())
+    {
+        std::ostringstream text;
+        text << "Ran " << iteration << " iterations";
+        if(options.shuffle)
+            text << ", shuffled from --shuffle=" << shuffleSeed;
+        text << ".\n";
+        report(text.str());
+    }
+    else if(options.shuffle && failed > 0)
+        report("Shuffled with --shuffle=" + std::to_string(shuffleSeed) + ".\n");
+
+    saveRunState();
+    stateFile = nullptr;
+#ifdef SLIMTEST_HAS_COVERAGE
+    if(covering && !writeCoverage(options.coverage, name, options.coverageSources))
+        output("Could not write coverage " + options.coverage + ".\n");
+    covering = false;
+#endif
+
+    reportProfiles();
+    for(auto&& reporter : activeReporters)
+        reporter->runFinished(finishedTests - failedTests, runs);
+    activeReporters.clear();
+
+    writing.reset();
+    sink = nullptr;
+#ifndef SLIMTEST_WINDOWS
+    for(size_t i = 0; i < guarded; ++i)
+        std::signal(fatal[i], previousHandlers[i]);
+#endif
+
+    return (int)failed;
+}
+
+inline size_t TestRunner::runBenchmarks(const Options& options)
+{
+    BenchmarkSamples baseline;
+    if(!options.benchmarkCompare.empty() && !loadBenchmarkSamples(options.benchmarkCompare, baseline))
+    {
+        std::cerr << "Could not read benchmark baseline " << options.benchmarkCompare << "." << std::endl;
+        return 1;
+    }
+
+    // Results go through the background writer, like the reports of a test run
+    std::unique_ptr<OutputSink> writing(new OutputSink());
+    sink = writing.get();
+
+    Context context(true);
+    BenchmarkSamples results;
+    size_t failed = 0;
+    size_t regressed = 0;
+    size_t total = 0;
+    for(auto&& benchmark : benchmarks)
+    {
+        if(!selected(benchmark.name, options))
+            continue;
+        ++total;
+        collect(context);
+        context.reset();
+        std::vector<double> samples = measure(benchmark, options);
+        collect(context);
+        if(context.failedAssertions > 0)
+        {
+            std::ostringstream text;
+            formatFailures(text, context.failures);
+            text << "Benchmark " << benchmark.name << " FAILED\n\n";
+            report(text.str());
+            ++failed;
+            continue;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        const double median = samples[samples.size() / 2];
+        const double p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2) << "Benchmark " << benchmark.name
+            << ": min " << samples.front() << " ns, median " << median << " ns, p99 " << p99
+            << " ns per iteration, " << std::setprecision(0) << 1e9 / median << " iterations/s\n";
+
+        // Only a slowdown that is both statistically significant and larger than the
+        // threshold counts, so run to run noise cannot break the build
+        BenchmarkSamples::const_iterator previous = baseline.find(benchmark.name);
+        if(previous != baseline.end() && !previous->second.empty())
+        {
+            std::vector<double> before = previous->second;
+            std::sort(before.begin(), before.end());
+            const double beforeMedian = before[before.size() / 2];
+            const double change = 100.0 * (median - beforeMedian) / beforeMedian;
+            const double pValue = mannWhitneyPValue(before, samples);
+            const bool slower = pValue < options.benchmarkAlpha && change > options.benchmarkThreshold;
+            text << "    Baseline median " << std::setprecision(2) << beforeMedian << " ns, "
+                << std::showpos << change << std::noshowpos << "% (p = " << std::setprecision(4)
+                << pValue << ")" << (slower ? ", REGRESSED" : "") << "\n";
+            if(slower)
+                ++regressed;
+        }
+        report(text.str());
+        results[benchmark.name].swap(samples);
+    }
+
+    std::ostringstream summary;
+    summary << total - failed << " benchmarks passed out of " << total << " benchmarks";
+    if(!baseline.empty())
+        summary << ", " << regressed << " regressed against " << options.benchmarkCompare;
+    summary << ".\n";
+    report(summary.str());
+
+    // Results that were not saved cannot be compared against, so the run fails
+    const bool unsaved = !options.benchmarkSave.empty() && !saveBenchmarkSamples(options.benchmarkSave, results);
+    writing.reset();
+    sink = nullptr;
+    if(unsaved)
+        std::cerr << "Could not write benchmark baseline " << options.benchmarkSave << "." << std::endl;
+    return failed + regressed + (unsaved ? 1 : 0);
+}
+
+// Baselines are plain text, one benchmark per line: its name followed by its samples
+inline bool TestRunner::loadBenchmarkSamples(const std::string& path, BenchmarkSamples& samples)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+        return false;
+
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        if(!(fields >> name))
+            continue;
+        std::vector<double>& values = samples[name];
+        double value;
+        while(fields >> value)
+            values.push_back(value);
+    }
+    return true;
+}
+
+inline bool TestRunner::saveBenchmarkSamples(const std::string& path, const BenchmarkSamples& samples)
+{
+    std::ofstream file(path.c_str());
+    file << std::setprecision(17);
+    for(auto&& entry : samples)
+    {
+        file << entry.first;
+        for(auto&& value : entry.second)
+            file << ' ' << value;
+        file << '\n';
+    }
+    return (bool)file;
+}
+
+inline bool TestRunner::loadState(const std::string& path, RunState& state)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+        return false;
+
+    // Names and paths may hold spaces, so they take up the rest of the line
+    int version = 1;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string kind;
+        std::string value;
+        std::string name;
+        double wallTime = -1.0;
+        if(!(fields >> kind >> value))
+            continue;
+        if(kind == "version")
+        {
+            version = std::atoi(value.c_str());
+            if(version < 1 || version > stateVersion)
+            {
+                std::cerr << "Ignoring " << path << ", its layout " << value << " is newer than this SlimTest's "
+                    << stateVersion << "." << std::endl;
+                state = RunState();
+                return false;
+            }
+            continue;
+        }
+        if((kind == "test" && version >= 2 && !(fields >> wallTime)) || !std::getline(fields >> std::ws, name))
+            continue;
+        if(kind == "file")
+            state.files[name] = std::strtoull(value.c_str(), nullptr, 16);
+        else if(kind == "test")
+        {
+            TestHistory history = { value == "failed", wallTime };
+            state.tests[name] = history;
+        }
+    }
+    return true;
+}
+
+inline bool TestRunner::saveState(const std::string& path, const RunState& state)
+{
+    std::ofstream file(path.c_str());
+    file << "version " << stateVersion << '\n';
+    for(auto&& entry : state.files)
+        file << "file " << std::hex << entry.second << std::dec << ' ' << entry.first << '\n';
+    for(auto&& entry : state.tests)
+    {
+        file << "test " << (entry.second.failed ? "failed" : "passed") << ' ' << entry.second.wallTime
+            << ' ' << entry.first << '\n';
+    }
+    return (bool)file;
+}
+
+// 64 bit FNV-1a of the file's contents
+inline bool TestRunner::hashFile(const char* path, std::uint64_t& hash)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+
+    hash = 0xcbf29ce484222325ULL;
+    char buffer[65536];
+    while(file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+    {
+        const std::streamsize read = file.gcount();
+        for(std::streamsize i = 0; i < read; ++i)
+            hash = (hash ^ (unsigned char)buffer[i]) * 0x100000001b3ULL;
+    }
+    return true;
+}
+
+// Tests that failed last time, then tests that are new or registered from a source file that
+// changed or cannot be read
+inline std::vector<size_t> TestRunner::changedTests(const RunState& state,
+    const std::map<std::string, std::uint64_t>& hashes) const
+{
+    std::vector<size_t> failed;
+    std::vector<size_t> changed;
+    for(auto&& index : selection)
+    {
+        const TestCase& test = testCases[index];
+        std::map<std::string, TestHistory>::const_iterator history = state.tests.find(test.name);
+        std::map<std::string, std::uint64_t>::const_iterator hash = hashes.find(test.file);
+        std::map<std::string, std::uint64_t>::const_iterator previous = state.files.find(test.file);
+        if(history != state.tests.end() && history->second.failed)
+            failed.push_back(index);
+        else if(history == state.tests.end() || hash == hashes.end() || previous == state.files.end()
+            || previous->second != hash->second)
+            changed.push_back(index);
+    }
+    failed.insert(failed.end(), changed.begin(), changed.end());
+    return failed;
+}
+
+// A file's new hash is only recorded once every test it registers has run, so tests that were
+// filtered out still count as changed next time
+inline void TestRunner::updateState(RunState& state, const std::map<std::string, std::uint64_t>& hashes) const
+{
+    std::map<std::string, bool> complete;
+    for(size_t index = 0; index < testCases.size(); ++index)
+    {
+        const TestCase& test = testCases[index];
+        bool& ran = complete.insert(std::make_pair(std::string(test.file), true)).first->second;
+        ran = ran && outcomes[index] >= 0;
+        if(outcomes[index] >= 0)
+        {
+            TestHistory history = { outcomes[index] > 0, wallTimes[index] };
+            state.tests[test.name] = history;
+        }
+    }
+
+    for(auto&& file : complete)
+    {
+        std::map<std::string, std::uint64_t>::const_iterator hash = hashes.find(file.first);
+        if(file.second && hash != hashes.end())
+            state.files[file.first] = hash->second;
+    }
+
+    // Forget whatever no longer exists
+    for(std::map<std::string, std::uint64_t>::iterator file = state.files.begin(); file != state.files.end();)
+        file = complete.count(file->first) ? ++file : state.files.erase(file);
+    for(std::map<std::string, TestHistory>::iterator test = state.tests.begin(); test != state.tests.end();)
+        test = testIndex.count(test->first) ? ++test : state.tests.erase(test);
+}
+
+// Writes what this run found out to the --state file, if there is one
+inline void TestRunner::saveRunState()
+{
+    if(!stateFile)
+        return;
+    updateState(stateFile->state, stateFile->hashes);
+    if(!saveState(stateFile->path, stateFile->state))
+        output("Could not write test state " + stateFile->path + ".\n");
+}
+
+inline void TestRunner::orderTests(const RunState& state, const std::string& order)
+{
+    if(order == "failed-first")
+    {
+        std::stable_partition(selection.begin(), selection.end(), [&](size_t index)
+        {
+            std::map<std::string, TestHistory>::const_iterator test = state.tests.find(testCases[index].name);
+            return test != state.tests.end() && test->second.failed;
+        });
+    }
+    else if(order == "shortest-first")
+    {
+        // Tests without a history have not run yet and are the most interesting, so they go first
+        std::stable_sort(selection.begin(), selection.end(), [&](size_t lhs, size_t rhs)
+        {
+            return expectedTimes[lhs] < expectedTimes[rhs];
+        });
+    }
+}
+
+// The selection longest first when every selected test has a known duration and no other
+// order was asked for, otherwise nothing
+inline std::vector<size_t> TestRunner::longestFirst() const
+{
+    std::vector<size_t> longest;
+    if(!balance)
+        return longest;
+    for(auto&& index : selection)
+    {
+        if(expectedTimes[index] < 0)
+            return longest;
+    }
+    longest = selection;
+    std::stable_sort(longest.begin(), longest.end(), [&](size_t lhs, size_t rhs)
+    {
+        return expectedTimes[lhs] > expectedTimes[rhs];
+    });
+    return longest;
+}
+
+// Fisher-Yates driven by mt19937_64, whose output the standard fixes, so a seed reproduces
+// the same order with every standard library
+inline void TestRunner::shuffleTests(std::uint64_t seed)
+{
+    std::mt19937_64 random(seed);
+    for(size_t position = selection.size(); position > 1; --position)
+        std::swap(selection[position - 1], selection[(size_t)(random() % position)]);
+}
+
+inline void TestRunner::countFixtureUsers()
+{
+    for(auto&& test : testCases)
+    {
+        if(test.fixture)
+            test.fixture->users = 0;
+    }
+    for(auto&& index : selection)
+    {
+        if(testCases[index].fixture)
+            ++testCases[index].fixture->users;
+    }
+}
+
+inline bool TestRunner::stopped() const
+{
+    return failLimit > 0 && failedTests >= failLimit;
+}
+
+// One sided Mann-Whitney U test using the tie corrected normal approximation. Small
+// values mean the current samples are very likely larger, i.e. slower, than the baseline.
+inline double TestRunner::mannWhitneyPValue(const std::vector<double>& baseline, const std::vector<double>& current)
+{
+    std::vector<std::pair<double, bool>> combined;
+    for(auto&& value : baseline)
+        combined.push_back(std::make_pair(value, false));
+    for(auto&& value : current)
+        combined.push_back(std::make_pair(value, true));
+    std::sort(combined.begin(), combined.end());
+
+    const double count = (double)combined.size();
+    double currentRanks = 0;
+    double ties = 0;
+    for(size_t first = 0; first < combined.size();)
+    {
+        size_t last = first;
+        while(last + 1 < combined.size() && combined[last + 1].first == combined[first].first)
+            ++last;
+        const double tied = (double)(last - first + 1);
+        const double rank = (first + last) / 2.0 + 1;
+        for(size_t i = first; i <= last; ++i)
+        {
+            if(combined[i].second)
+                currentRanks += rank;
+        }
+        ties += tied * tied * tied - tied;
+        first = last + 1;
+    }
+
+    const double before = (double)baseline.size();
+    const double after = (double)current.size();
+    const double u = currentRanks - after * (after + 1) / 2;
+    const double mean = before * after / 2;
+    const double variance = before * after / 12 * ((count + 1) - ties / (count * (count - 1)));
+    if(variance <= 0)
+        return 1.0;
+
+    const double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+inline std::vector<double> TestRunner::measure(const Benchmark& benchmark, const Options& options)
+{
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double, std::nano> Nanoseconds;
+
+    const double sampleTime = 1e6 * options.benchmarkTime / options.benchmarkSamples;
+    auto time = [&benchmark](size_t iterations)
+    {
+        const Clock::time_point start = Clock::now();
+        benchmark.function(iterations);
+        return Nanoseconds(Clock::now() - start).count();
+    };
+
+    // Grow the iteration count until one sample is long enough to time reliably
+    size_t iterations = 1;
+    double elapsed = time(iterations);
+    while(elapsed < sampleTime)
+    {
+        const double scale = (elapsed > 0) ? 1.2 * sampleTime / elapsed : 10.0;
+        const size_t grown = (size_t)(iterations * std::min(10.0, std::max(2.0, scale)));
+        iterations = (grown > iterations) ? grown : iterations + 1;
+        elapsed = time(iterations);
+    }
+
+    // Warm caches, branch predictors and clock frequency before recording anything
+    const Clock::time_point warmupEnd = Clock::now()
+        + std::chrono::milliseconds(options.benchmarkTime / 10);
+    while(Clock::now() < warmupEnd)
+        time(iterations);
+
+    std::vector<double> samples;
+    samples.reserve(options.benchmarkSamples);
+    for(size_t sample = 0; sample < options.benchmarkSamples; ++sample)
+        samples.push_back(time(iterations) / iterations);
+    return samples;
+}
+
+inline size_t TestRunner::runSequential()
+{
+    // Threads spawned by a test are bound to no context, so while only one test runs
+    // at a time their assertions are attributed to it
+    Context context(true);
+    if(watchdog)
+        watchdog->watch(context);
+
+    size_t failed = 0;
+    for(auto&& index : selection)
+    {
+        if(stopped())
+            break;
+        if(runTest(index, context))
+            ++failed;
+    }
+
+    if(watchdog)
+        watchdog->unwatch(context);
+    return failed;
+}
+
+inline size_t TestRunner::runParallel(size_t jobs)
+{
+    std::vector<WorkQueue> queues(jobs);
+    const size_t total = selection.size();
+    const std::vector<size_t> longest = longestFirst();
+    if(!longest.empty())
+    {
+        // Known durations: hand each test, longest first, to the least loaded worker. Workers
+        // pop from the back, so the longest tests are pushed last and start first.
+        std::vector<double> loads(jobs, 0.0);
+        std::vector<std::vector<size_t>> dealt(jobs);
+        for(auto&& index : longest)
+        {
+            const size_t worker = std::min_element(loads.begin(), loads.end()) - loads.begin();
+            loads[worker] += (expectedTimes[index] > 0) ? expectedTimes[index] : 0.0;
+            dealt[worker].push_back(index);
+        }
+        for(size_t worker = 0; worker < jobs; ++worker)
+        {
+            for(size_t position = dealt[worker].size(); position > 0; --position)
+                queues[worker].push(dealt[worker][position - 1]);
+        }
+    }
+    else
+    {
+        // Deal out contiguous blocks so neighbouring tests start on the same worker
+        for(size_t position = 0; position < total; ++position)
+            queues[position * jobs / total].push(selection[position]);
+    }
+
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> workers;
+    for(size_t worker = 0; worker < jobs; ++worker)
+    {
+        workers.emplace_back([this, worker, jobs, &queues, &failed]()
+        {
+            Context context;
+            threadState().owner = &context;
+            if(watchdog)
+                watchdog->watch(context);
+            size_t index;
+            for(;;)
+            {
+                if(stopped())
+                    break;
+                bool found = queues[worker].pop(index);
+                for(size_t victim = 1; !found && victim < jobs; ++victim)
+                    found = queues[(worker + victim) % jobs].steal(index);
+                if(!found)
+                    break;
+                if(runTest(index, context))
+                    ++failed;
+            }
+            if(watchdog)
+                watchdog->unwatch(context);
+            threadState().owner = nullptr;
+        });
+    }
+
+    for(auto&& worker : workers)
+        worker.join();
+
+    // Whatever threads bound to no test asserted during the run can only be reported as a whole
+    Context detached(true);
+    collect(detached);
+    if(detached.failedAssertions > 0)
+    {
+        TestResult result;
+        result.name = "threads bound to no test function";
+        result.status = Failed;
+        result.assertions = detached.totalAssertions;
+        result.failures.swap(detached.failures);
+        finishUnbound(result);
+        ++failed;
+    }
+
+    return failed;
+}
+
+inline bool TestRunner::runTest(size_t index, Context& context)
+{
+    executeTest(index, context);
+
+    TestResult result;
+    result.name = testName(index);
+    result.status = (context.failedAssertions > 0) ? Failed : Passed;
+    result.assertions = context.totalAssertions;
+    result.failures.swap(context.failures);
+    result.profile = context.profile;
+    finish(result);
+    return result.status != Passed;
+}
+
+inline void TestRunner::executeTest(size_t index, Context& context)
+{
+    // Drop anything asserted since the last collection so it cannot leak into this test
+    collect(context);
+    context.reset();
+#ifdef SLIMTEST_HAS_COVERAGE
+    if(covering)
+        std::memset(coverageMap().reached, 0, sizeof(coverageMap().reached));
+#endif
+
+    const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    const double cpuStarted = cpuTime(context.sole);
+    const std::int64_t memoryStarted = peakMemory();
+    const TestCase& test = testCases[index];
+    ThreadState& state = threadState();
+    state.lastAssertion.store(nullptr, std::memory_order_relaxed);
+    FixtureSlot* fixture = test.fixture;
+    std::unique_lock<std::mutex> fixtureLock;
+    bool ready = true;
+    if(fixture)
+    {
+        fixtureLock = std::unique_lock<std::mutex>(fixture->mutex);
+        ready = guard(test, [fixture]()
+        {
+            if(!fixture->instance)
+                fixture->instance = fixture->create();
+        });
+    }
+
+    // A shared fixture is built before and kept after, so only the test with its setUp and
+    // tearDown is charged for the blocks left allocated
+    context.runner = &state;
+    state.executing = &context;
+    openLedger(state.ledger);
+    state.charged = &state.ledger;
+    if(fixture && ready)
+        ready = guard(test, [fixture]() { fixture->instance->setUp(); });
+
+    context.running = index;
+    context.budget = testTimeout(index);
+    if(context.budget > 0)
+        context.deadline.store(steadyMilliseconds() + context.budget, std::memory_order_release);
+    if(ready)
+        guard(test, test.function);
+    if(context.budget > 0 && context.deadline.exchange(0) < 0)
+    {
+        // Too late, the watchdog is ending the run
+        for(;;)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    if(fixture && ready)
+        guard(test, [fixture]() { fixture->instance->tearDown(); });
+    state.charged = nullptr;
+    state.executing = nullptr;
+    closeLedger(test, state.ledger);
+    if(fixture && --fixture->users == 0)
+    {
+        delete fixture->instance;
+        fixture->instance = nullptr;
+    }
+    context.profile.index = index;
+    context.profile.wallTime = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+    context.profile.cpuTime = (cpuTime(context.sole) - cpuStarted) / 1e6;
+    context.profile.memoryGrowth = peakMemory() - memoryStarted;
+#ifdef SLIMTEST_HAS_COVERAGE
+    if(covering)
+        harvestCoverage(index);
+#endif
+
+    collect(context);
+}
+
+#ifndef SLIMTEST_WINDOWS
+inline size_t TestRunner::runIsolated(size_t processes)
+{
+    // Workers time their tests out themselves, this only catches a worker too stuck to do so
+    const unsigned grace = 1000;
+    // A worker dying mid-write must not take the parent down with it
+    void (*previousHandler)(int) = std::signal(SIGPIPE, SIG_IGN);
+
+    const size_t total = selection.size();
+    const std::vector<size_t> longest = longestFirst();
+    const std::vector<size_t>& order = longest.empty() ? selection : longest;
+    std::vector<Worker> workers(processes);
+    size_t next = 0;
+    size_t busy = 0;
+    size_t failed = 0;
+
+    auto dispatch = [&](Worker& worker)
+    {
+        while(next < total && !stopped() && (worker.pid > 0 || spawnWorker(worker)))
+        {
+            const std::uint64_t index = order[next++];
+            if(writeAll(worker.toChild, &index, sizeof(index)))
+            {
+                worker.index = (size_t)index;
+                worker.busy = true;
+                worker.started = std::chrono::steady_clock::now();
+                ++busy;
+                return;
+            }
+            // The worker died between tests; hand the index to a fresh one
+            --next;
+            stopWorker(worker);
+        }
+    };
+
+    auto fail = [&](Worker& worker, Status status, const std::string& detail)
+    {
+        stopWorker(worker);
+        TestResult result;
+        result.name = testName(worker.index);
+        result.status = status;
+        result.detail = detail;
+        result.profile.index = worker.index;
+        result.profile.wallTime = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - worker.started).count();
+        finish(result);
+        worker.busy = false;
+        --busy;
+        ++failed;
+    };
+
+    for(auto&& worker : workers)
+        dispatch(worker);
+
+    std::vector<pollfd> descriptors;
+    std::vector<Worker*> polled;
+    while(busy > 0)
+    {
+        descriptors.clear();
+        polled.clear();
+        int wait = -1;
+        const auto now = std::chrono::steady_clock::now();
+        for(auto&& worker : workers)
+        {
+            if(!worker.busy)
+                continue;
+            pollfd descriptor = { worker.fromChild, POLLIN, 0 };
+            descriptors.push_back(descriptor);
+            polled.push_back(&worker);
+            const unsigned timeout = testTimeout(worker.index);
+            if(timeout > 0)
+            {
+                const long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - worker.started).count() - grace;
+                const int remaining = (elapsed >= timeout) ? 0 : (int)(timeout - elapsed);
+                if(wait < 0 || remaining < wait)
+                    wait = remaining;
+            }
+        }
+
+        if(poll(descriptors.data(), descriptors.size(), wait) < 0 && errno != EINTR)
+            break;
+
+        for(size_t i = 0; i < polled.size(); ++i)
+        {
+            Worker& worker = *polled[i];
+            if(descriptors[i].revents != 0)
+            {
+                char buffer[4096];
+                const ssize_t received = read(worker.fromChild, buffer, sizeof(buffer));
+                if(received <= 0)
+                {
+                    if(received < 0 && errno == EINTR)
+                        continue;
+                    int status = 0;
+                    const pid_t pid = worker.pid;
+                    close(worker.toChild);
+                    close(worker.fromChild);
+                    worker.pid = -1;
+                    waitpid(pid, &status, 0);
+                    std::ostringstream reason;
+                    if(WIFSIGNALED(status))
+                        reason << strsignal(WTERMSIG(status));
+                    else
+                        reason << "exit status " << WEXITSTATUS(status);
+                    fail(worker, Crashed, reason.str());
+                    dispatch(worker);
+                    continue;
+                }
+
+                worker.received.append(buffer, (size_t)received);
+                WorkerResult result;
+                if(worker.received.size() < sizeof(result))
+                    continue;
+                std::memcpy(&result, worker.received.data(), sizeof(result));
+                const size_t end = sizeof(result) + (size_t)result.detail + (size_t)result.length;
+                if(worker.received.size() < end)
+                    continue;
+
+                TestResult finished;
+                finished.name = testName(worker.index);
+                finished.status = (Status)result.status;
+                finished.detail = worker.received.substr(sizeof(result), (size_t)result.detail);
+                finished.assertions = (size_t)result.assertions;
+                finished.profile = result.profile;
+                for(size_t offset = sizeof(result) + (size_t)result.detail; offset < end;)
+                {
+                    std::uint64_t header[2];
+                    std::memcpy(header, worker.received.data() + offset, sizeof(header));
+                    offset += sizeof(header);
+                    Failure failure = { reinterpret_cast<const Assertion*>((std::uintptr_t)header[0]),
+                        worker.received.substr(offset, (size_t)header[1]) };
+                    finished.failures.push_back(failure);
+                    offset += (size_t)header[1];
+                }
+                finish(finished);
+                worker.received.clear();
+                worker.busy = false;
+                --busy;
+                if(finished.status != Passed)
+                    ++failed;
+                // A worker that timed out exits, its test is still running
+                if(finished.status == TimedOut)
+                    stopWorker(worker);
+                dispatch(worker);
+            }
+            else if(testTimeout(worker.index) > 0 && std::chrono::steady_clock::now() - worker.started
+                >= std::chrono::milliseconds(testTimeout(worker.index) + grace))
+            {
+                std::ostringstream reason;
+                reason << "after " << testTimeout(worker.index) << " ms";
+                fail(worker, TimedOut, reason.str());
+                dispatch(worker);
+            }
+        }
+    }
+
+    for(auto&& worker : workers)
+        stopWorker(worker);
+
+    std::signal(SIGPIPE, previousHandler);
+    return failed;
+}
+
+inline bool TestRunner::spawnWorker(Worker& worker)
+{
+    int toChild[2];
+    int fromChild[2];
+    if(pipe(toChild) != 0)
+        return false;
+    if(pipe(fromChild) != 0)
+    {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+
+    // Nothing buffered may be inherited, and the writer must be idle so it holds no locks
+    if(sink)
+        sink->flush();
+    std::cout.flush();
+    const pid_t pid = fork();
+    if(pid == 0)
+    {
+        // The writer thread did not survive the fork
+        if(sink)
+            sink->abandon();
+        sink = nullptr;
+        close(toChild[1]);
+        close(fromChild[0]);
+        serveWorker(toChild[0], fromChild[1]);
+    }
+
+    close(toChild[0]);
+    close(fromChild[1]);
+    if(pid < 0)
+    {
+        close(toChild[1]);
+        close(fromChild[0]);
+        return false;
+    }
+
+    worker.pid = pid;
+    worker.toChild = toChild[1];
+    worker.fromChild = fromChild[0];
+    worker.received.clear();
+    return true;
+}
+
+inline void TestRunner::serveWorker(int input, int output)
+{
+    Context context(true);
+    workerOutput = output;
+    bool timed = false;
+    for(auto&& index : selection)
+        timed = timed || testTimeout(index) > 0;
+    std::unique_ptr<Watchdog> watching(timed ? new Watchdog() : nullptr);
+    watchdog = watching.get();
+    if(watchdog)
+        watchdog->watch(context);
+
+    std::uint64_t index;
+    while(readAll(input, &index, sizeof(index)) && index < testCases.size())
+    {
+        executeTest((size_t)index, context);
+
+        std::string failures;
+        for(auto&& failure : context.failures)
+        {
+            const std::uint64_t header[2] = { (std::uintptr_t)failure.assertion, failure.values.size() };
+            failures.append(reinterpret_cast<const char*>(header), sizeof(header));
+            failures.append(failure.values);
+        }
+
+        WorkerResult result;
+        result.index = index;
+        result.status = (context.failedAssertions > 0) ? Failed : Passed;
+        result.assertions = context.totalAssertions;
+        result.detail = 0;
+        result.length = failures.size();
+        result.profile = context.profile;
+
+        std::cout.flush();
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if(!writeAll(output, &result, sizeof(result)) || !writeAll(output, failures.data(), failures.size()))
+            break;
+    }
+
+    if(watchdog)
+        watchdog->unwatch(context);
+
+    releaseFixtures();
+    std::cout.flush();
+    _exit(0);
+}
+
+inline void TestRunner::stopWorker(Worker& worker)
+{
+    if(worker.pid <= 0)
+        return;
+
+    kill(worker.pid, SIGKILL);
+    close(worker.toChild);
+    close(worker.fromChild);
+    int status;
+    waitpid(worker.pid, &status, 0);
+    worker.pid = -1;
+    worker.received.clear();
+}
+
+inline bool TestRunner::readAll(int descriptor, void* buffer, size_t size)
+{
+    char* position = static_cast<char*>(buffer);
+    while(size > 0)
+    {
+        const ssize_t count = read(descriptor, position, size);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return false;
+        position += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+inline bool TestRunner::writeAll(int descriptor, const void* buffer, size_t size)
+{
+    const char* position = static_cast<const char*>(buffer);
+    while(size > 0)
+    {
+        const ssize_t count = write(descriptor, position, size);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return false;
+        position += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+inline void TestRunner::readUntilClosed(int descriptor, std::string& text)
+{
+    char buffer[4096];
+    for(ssize_t count; (count = read(descriptor, buffer, sizeof(buffer))) != 0;)
+    {
+        if(count < 0 && errno != EINTR)
+            break;
+        if(count > 0)
+            text.append(buffer, (size_t)count);
+    }
+}
+
+// A statement that neither dies nor returns is killed once the running test's budget is
+// spent, or after a minute for a test without one
+inline unsigned TestRunner::deathBudget()
+{
+    const ThreadState& state = threadState();
+    const Context* test = state.owner ? state.owner.load() : state.executing;
+    const std::int64_t deadline = test ? test->deadline.load(std::memory_order_acquire) : 0;
+    if(deadline <= 0)
+        return 60000;
+    const std::int64_t remaining = deadline - steadyMilliseconds();
+    return (remaining > 0) ? (unsigned)remaining : 1;
+}
+
+// Returns 0 in the child, whose stderr now goes to errors, and the child's pid or -1 in the parent
+inline pid_t TestRunner::forkDeathTest(int& errors, int& returned)
+{
+    int errorPipe[2];
+    int returnPipe[2];
+    if(pipe(errorPipe) != 0)
+        return -1;
+    if(pipe(returnPipe) != 0)
+    {
+        close(errorPipe[0]);
+        close(errorPipe[1]);
+        return -1;
+    }
+
+    // Nothing buffered may be inherited, and the writer must be idle so it holds no locks
+    TestRunner& runner = testRunner();
+    if(runner.sink)
+        runner.sink->flush();
+    std::cout.flush();
+    std::cerr.flush();
+    const pid_t pid = fork();
+    if(pid == 0)
+    {
+        // Only the forking thread lives on, and dying is expected: no crash reports, no core dumps
+        if(runner.sink)
+            runner.sink->abandon();
+        runner.sink = nullptr;
+        const int fatal[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS, SIGALRM };
+        for(auto&& number : fatal)
+            std::signal(number, SIG_DFL);
+        const rlimit noCore = { 0, 0 };
+        setrlimit(RLIMIT_CORE, &noCore);
+        // Outlasts the parent's deadline, should the parent be gone before it can kill the child
+        alarm(deathBudget() / 1000 + 2);
+        dup2(errorPipe[1], STDERR_FILENO);
+        close(errorPipe[0]);
+        close(errorPipe[1]);
+        close(returnPipe[0]);
+        returned = returnPipe[1];
+        return 0;
+    }
+
+    close(errorPipe[1]);
+    close(returnPipe[1]);
+    if(pid < 0)
+    {
+        close(errorPipe[0]);
+        close(returnPipe[0]);
+        return -1;
+    }
+    errors = errorPipe[0];
+    returned = returnPipe[0];
+    return pid;
+}
+
+inline void TestRunner::awaitDeath(const Assertion& assertion, pid_t child, int errors, int returned,
+    const char* pattern, const int* code)
+{
+    // Read both pipes at once, the child only reports surviving once it is done with stderr
+    const unsigned budget = deathBudget();
+    const std::int64_t deadline = steadyMilliseconds() + budget;
+    std::string written;
+    std::string survived;
+    std::string* const texts[] = { &written, &survived };
+    pollfd descriptors[] = { { errors, POLLIN, 0 }, { returned, POLLIN, 0 } };
+    bool killed = false;
+    int status = 0;
+    for(;;)
+    {
+        const std::int64_t remaining = deadline - steadyMilliseconds();
+        if(remaining <= 0)
+        {
+            kill(child, SIGKILL);
+            killed = true;
+            break;
+        }
+        if(descriptors[0].fd < 0 && descriptors[1].fd < 0)
+        {
+            // Both pipes closed, the child is on its way out
+            const pid_t waited = waitpid(child, &status, WNOHANG);
+            if(waited == child || (waited < 0 && errno != EINTR))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if(poll(descriptors, 2, (int)remaining) < 0 && errno != EINTR)
+        {
+            kill(child, SIGKILL);
+            break;
+        }
+        for(size_t i = 0; i < 2; ++i)
+        {
+            if(descriptors[i].fd < 0 || descriptors[i].revents == 0)
+                continue;
+            char buffer[4096];
+            const ssize_t count = read(descriptors[i].fd, buffer, sizeof(buffer));
+            if(count > 0)
+                texts[i]->append(buffer, (size_t)count);
+            else if(count == 0 || errno != EINTR)
+                descriptors[i].fd = -1;
+        }
+    }
+    close(errors);
+    close(returned);
+    if(killed || descriptors[0].fd >= 0 || descriptors[1].fd >= 0)
+    {
+        while(waitpid(child, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+
+    std::ostringstream failure;
+    if(killed)
+        failure << "still running after " << budget << " ms, killed";
+    else if(!survived.empty())
+        failure << "statement " << survived;
+    else if(WIFSIGNALED(status) && code)
+        failure << "killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+    else if(WIFEXITED(status) && (code ? WEXITSTATUS(status) != *code : WEXITSTATUS(status) == 0))
+        failure << "exited with status " << WEXITSTATUS(status);
+    else
+    {
+        try
+        {
+            if(std::regex_search(written, std::regex(pattern)))
+                return;
+            failure << "stderr did not match";
+        }
+        catch(const std::regex_error& error)
+        {
+            failure << "invalid pattern: " << error.what();
+        }
+    }
+
+    const size_t shown = 512;
+    written.erase(written.find_last_not_of("\r\n") + 1);
+    if(!written.empty())
+        failure << ", stderr: \"" << written.substr(0, shown) << (written.size() > shown ? "...\"" : "\"");
+    recordFailure(assertion, failure.str());
+}
+#endif
+
+inline void TestRunner::formatFailures(std::ostream& stream, const std::vector<Failure>& failures)
+{
+    for(auto&& failure : failures)
+    {
+        const Assertion& assertion = *failure.assertion;
+        stream << "Assertion failed: " << assertion.expression << ".\n"
+            << "    Expected " << assertion.expectation;
+        if(!failure.values.empty())
+            stream << " (" << failure.values << ")";
+        stream << "\n    At: " << assertion.file << " " << assertion.line << "\n";
+    }
+}
+
+inline const std::string& TestRunner::testName(size_t index) const
+{
+    return testCases[index].name;
+}
+
+inline std::vector<size_t> TestRunner::select(const Options& options) const
+{
+    std::vector<size_t> indices;
+
+    // Plain names are looked up directly, so running a single test costs nothing extra
+    bool exact = !options.includes.empty();
+    for(auto&& include : options.includes)
+        exact = exact && include.find_first_of("*?") == std::string::npos;
+    if(exact)
+    {
+        for(auto&& include : options.includes)
+        {
+            std::unordered_map<std::string, size_t>::const_iterator found = testIndex.find(include);
+            if(found != testIndex.end() && selected(include, options))
+                indices.push_back(found->second);
+        }
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    }
+    else
+    {
+        for(size_t index = 0; index < testCases.size(); ++index)
+        {
+            if(selected(testCases[index].name, options))
+                indices.push_back(index);
+        }
+    }
+
+    // Move the tests sharing a fixture up behind the first of them, so it is built only once
+    std::unordered_map<const FixtureSlot*, std::vector<size_t>> groups;
+    for(auto&& index : indices)
+    {
+        if(testCases[index].fixture)
+            groups[testCases[index].fixture].push_back(index);
+    }
+    if(groups.empty())
+        return indices;
+
+    std::vector<size_t> grouped;
+    grouped.reserve(indices.size());
+    for(auto&& index : indices)
+    {
+        const FixtureSlot* fixture = testCases[index].fixture;
+        if(!fixture)
+            grouped.push_back(index);
+        else if(groups.count(fixture))
+        {
+            grouped.insert(grouped.end(), groups[fixture].begin(), groups[fixture].end());
+            groups.erase(fixture);
+        }
+    }
+    return grouped;
+}
+
+inline bool TestRunner::selected(const std::string& name, const Options& options)
+{
+    bool included = options.includes.empty();
+    for(auto&& include : options.includes)
+        included = included || matchGlob(include.c_str(), name.c_str());
+    for(auto&& exclude : options.excludes)
+        included = included && !matchGlob(exclude.c_str(), name.c_str());
+    return included;
+}
+
+// '*' matches any run of characters and '?' any single one
+inline bool TestRunner::matchGlob(const char* pattern, const char* text)
+{
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while(*text)
+    {
+        if(*pattern == '*')
+        {
+            star = pattern++;
+            resume = text;
+        }
+        else if(*pattern == '?' || *pattern == *text)
+        {
+            ++pattern;
+            ++text;
+        }
+        else if(star)
+        {
+            pattern = star + 1;
+            text = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while(*pattern == '*')
+        ++pattern;
+    return *pattern == '\0';
+}
+
+inline std::string TestRunner::escapeXml(const std::string& text)
+{
+    std::string escaped;
+    for(auto&& character : text)
+    {
+        switch(character)
+        {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        case '\'': escaped += "&apos;"; break;
+        default: escaped += character; break;
+        }
+    }
+    return escaped;
+}
+
+inline std::string TestRunner::escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for(auto&& character : text)
+    {
+        switch(character)
+        {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if((unsigned char)character < 0x20)
+            {
+                static const char digits[] = "0123456789abcdef";
+                escaped += "\\u00";
+                escaped += digits[(character >> 4) & 0xF];
+                escaped += digits[character & 0xF];
+            }
+            else
+            {
+                escaped += character;
+            }
+            break;
+        }
+    }
+    return escaped;
+}
+
+inline void TestRunner::report(const std::string& text)
+{
+    if(text.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(reportMutex);
+    output(text);
+}
+
+inline void TestRunner::output(std::string text)
+{
+    TestRunner& runner = testRunner();
+    if(!runner.sink)
+    {
+        std::cout << text;
+        return;
+    }
+
+    // The writer thread frees what is posted, so it is not the running test's to free. Text
+    // allocated while charged to the test is copied, its buffer stays with the test.
+    ThreadState& state = threadState();
+    Ledger* charged = state.charged;
+    state.charged = nullptr;
+    runner.sink->post(charged ? new std::string(text) : new std::string(std::move(text)));
+    state.charged = charged;
+}
+
+#ifndef SLIMTEST_WINDOWS
+inline void TestRunner::crashed(int number)
+{
+    // Nothing here may lock or allocate, the crash may well have happened inside the writer
+    OutputSink* writer = testRunner().sink;
+    if(writer)
+        writer->salvage();
+    std::signal(number, SIG_DFL);
+    std::raise(number);
+}
+#endif
+
+inline void TestRunner::finish(const TestResult& result)
+{
+    std::lock_guard<std::mutex> lock(reportMutex);
+    ++finishedTests;
+    if(result.status != Passed)
+        ++failedTests;
+    if(outcomes[result.profile.index] <= 0)
+        outcomes[result.profile.index] = (result.status != Passed) ? 1 : 0;
+    wallTimes[result.profile.index] = result.profile.wallTime;
+    for(auto&& reporter : activeReporters)
+        reporter->testFinished(result);
+    if(profileLimit > 0)
+        profiles.push_back(result.profile);
+}
+
+// Failures no test function can be blamed for are reported, and counted in the exit code by the
+// caller, but are no test function's outcome
+inline void TestRunner::finishUnbound(const TestResult& result)
+{
+    std::lock_guard<std::mutex> lock(reportMutex);
+    for(auto&& reporter : activeReporters)
+        reporter->testFinished(result);
+}
+
+inline void TestRunner::addReporter(Reporter* reporter)
+{
+    testRunner().reporters.push_back(std::unique_ptr<Reporter>(reporter));
+}
+
+inline void TestRunner::reportProfiles()
+{
+    if(profileLimit == 0 || profiles.empty())
+        return;
+
+    const size_t shown = std::min(profileLimit, profiles.size());
+    std::ostringstream text;
+    auto print = [this, &text](const Profile& profile)
+    {
+        text << "    " << testName((size_t)profile.index) << ": " << profile.wallTime << " ms wall, "
+            << profile.cpuTime << " ms CPU, peak memory +" << profile.memoryGrowth << " KB, "
+            << profile.allocations << " allocations (" << profile.allocatedBytes << " bytes)\n";
+    };
+
+    text << std::fixed << std::setprecision(3);
+    std::partial_sort(profiles.begin(), profiles.begin() + shown, profiles.end(),
+        [](const Profile& lhs, const Profile& rhs) { return lhs.wallTime > rhs.wallTime; });
+    text << "Slowest test functions:\n";
+    for(size_t i = 0; i < shown; ++i)
+        print(profiles[i]);
+
+    // Allocations are only counted when SLIMTEST_COUNT_ALLOCATIONS hooks operator new
+    std::partial_sort(profiles.begin(), profiles.begin() + shown, profiles.end(),
+        [](const Profile& lhs, const Profile& rhs) { return lhs.allocatedBytes > rhs.allocatedBytes; });
+    if(profiles.front().allocations > 0)
+    {
+        text << "Most allocating test functions:\n";
+        for(size_t i = 0; i < shown; ++i)
+            print(profiles[i]);
+    }
+    text << "\n";
+    output(text.str());
+}
+
+#ifdef SLIMTEST_HAS_COVERAGE
+inline TestRunner::CoverageMap& TestRunner::coverageMap()
+{
+    static CoverageMap map;
+    return map;
+}
+
+inline std::uint32_t TestRunner::CoverageMap::slot(std::uintptr_t block)
+{
+    CoverageMap& map = coverageMap();
+    std::uint32_t index = (std::uint32_t)(((std::uint64_t)block * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+    for(int probe = 0; probe < probes; ++probe, index = (index + 1) & (capacity - 1))
+    {
+        // A failed exchange leaves whoever came first in taken, maybe this very block
+        std::uintptr_t taken = __atomic_load_n(&map.blocks[index], __ATOMIC_RELAXED);
+        if(taken == 0)
+            __atomic_compare_exchange_n(&map.blocks[index], &taken, block, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        if(taken == 0 || taken == block)
+            return index;
+    }
+    // Too crowded around here, the block goes uncounted
+    return capacity;
+}
+
+inline void TestRunner::CoverageMap::reach(std::uintptr_t block)
+{
+    const std::uint32_t index = slot(block);
+    CoverageMap& map = coverageMap();
+    if(index < capacity && !__atomic_load_n(&map.reached[index], __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&map.reached[index], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&map.growth, 1, __ATOMIC_RELAXED);
+    }
+}
+
+inline void TestRunner::CoverageMap::reachGuard(std::uint32_t* guard, std::uintptr_t block)
+{
+    // The guard remembers its block's slot after the first hit
+    std::uint32_t index = __atomic_load_n(guard, __ATOMIC_RELAXED);
+    if(index == unslotted)
+    {
+        index = slot(block);
+        __atomic_store_n(guard, index, __ATOMIC_RELAXED);
+    }
+    CoverageMap& map = coverageMap();
+    if(index < capacity && !__atomic_load_n(&map.reached[index], __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&map.reached[index], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&map.growth, 1, __ATOMIC_RELAXED);
+    }
+}
+
+inline void TestRunner::CoverageMap::initializeGuards(std::uint32_t* start, std::uint32_t* stop)
+{
+    // Called once per module, and again harmlessly by some runtimes
+    if(start == stop || *start)
+        return;
+    for(; start < stop; ++start)
+        *start = unslotted;
+}
+
+inline void TestRunner::CoverageMap::addTable(const std::uintptr_t* begin, const std::uintptr_t* end)
+{
+    CoverageMap& map = coverageMap();
+    const std::uint32_t table = __atomic_fetch_add(&map.tableCount, 1, __ATOMIC_RELAXED);
+    if(table < tableCapacity)
+    {
+        map.tables[table][0] = begin;
+        map.tables[table][1] = end;
+    }
+}
+
+inline void TestRunner::harvestCoverage(size_t index)
+{
+    const unsigned char* reached = coverageMap().reached;
+    std::vector<std::uint32_t>& slots = coveredSlots[index];
+    const size_t before = slots.size();
+    for(size_t word = 0; word < CoverageMap::capacity; word += sizeof(std::uint64_t))
+    {
+        std::uint64_t bytes;
+        std::memcpy(&bytes, reached + word, sizeof(bytes));
+        if(bytes == 0)
+            continue;
+        for(size_t slot = word; slot < word + sizeof(bytes); ++slot)
+            if(reached[slot])
+                slots.push_back((std::uint32_t)slot);
+    }
+    // A repeated test keeps the union of its runs
+    if(before > 0)
+    {
+        std::inplace_merge(slots.begin(), slots.begin() + before, slots.end());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+    }
+}
+
+inline bool TestRunner::writeCoverage(const std::string& path, const std::string& name,
+    const std::vector<std::string>& sources) const
+{
+    const CoverageMap& map = coverageMap();
+    // Reached blocks are known by the return address of their hook call, which may already
+    // be on the next line; pc-table entries are the blocks themselves
+    std::vector<std::uintptr_t> addresses;
+    for(auto&& slots : coveredSlots)
+        for(auto&& slot : slots)
+            addresses.push_back(map.blocks[slot] - 1);
+    const size_t tables = std::min<size_t>(map.tableCount, CoverageMap::tableCapacity);
+    for(size_t table = 0; table < tables; ++table)
+        for(const std::uintptr_t* entry = map.tables[table][0]; entry < map.tables[table][1]; entry += 2)
+            addresses.push_back(*entry);
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+    std::map<std::uintptr_t, SourceLine> lines;
+    symbolize(addresses, lines);
+    for(std::map<std::uintptr_t, SourceLine>::iterator line = lines.begin(); line != lines.end();)
+        line = coveredSource(line->second.file, sources) ? ++line : lines.erase(line);
+
+    std::ofstream file(path.c_str());
+    if(!file)
+        return false;
+
+    typedef std::map<std::string, std::set<int>> FileLines;
+    FileLines anyTest;
+    auto write = [&file](const std::string& test, const FileLines& files, int hits)
+    {
+        file << "TN:" << lcovName(test) << "\n";
+        for(auto&& source : files)
+        {
+            file << "SF:" << source.first << "\n";
+            for(auto&& line : source.second)
+                file << "DA:" << line << "," << hits << "\n";
+            file << "LF:" << source.second.size() << "\nLH:" << (hits ? source.second.size() : 0)
+                << "\nend_of_record\n";
+        }
+    };
+
+    for(size_t index = 0; index < coveredSlots.size(); ++index)
+    {
+        if(coveredSlots[index].empty())
+            continue;
+        FileLines reached;
+        for(auto&& slot : coveredSlots[index])
+        {
+            std::map<std::uintptr_t, SourceLine>::const_iterator line = lines.find(map.blocks[slot] - 1);
+            if(line != lines.end())
+                reached[line->second.file].insert(line->second.line);
+        }
+        for(auto&& source : reached)
+            anyTest[source.first].insert(source.second.begin(), source.second.end());
+        write(testName(index), reached, 1);
+    }
+
+    // Lines no test reached, known only from modules built with pc-table
+    FileLines unreached;
+    for(size_t table = 0; table < tables; ++table)
+    {
+        for(const std::uintptr_t* entry = map.tables[table][0]; entry < map.tables[table][1]; entry += 2)
+        {
+            std::map<std::uintptr_t, SourceLine>::const_iterator line = lines.find(*entry);
+            if(line == lines.end())
+                continue;
+            FileLines::const_iterator source = anyTest.find(line->second.file);
+            if(source == anyTest.end() || !source->second.count(line->second.line))
+                unreached[line->second.file].insert(line->second.line);
+        }
+    }
+    if(!unreached.empty())
+        write(name.empty() ? "unreached" : name, unreached, 0);
+    return (bool)file.flush();
+}
+
+// Lines of the standard library and of SlimTest itself are left out, and with --coverage-source
+// everything not under one of the given prefixes
+inline bool TestRunner::coveredSource(const std::string& file, const std::vector<std::string>& sources)
+{
+    const char* framework = __FILE__;
+    for(const char* character = __FILE__; *character; ++character)
+        if(*character == '/' || *character == '\\')
+            framework = character + 1;
+    const size_t slash = file.find_last_of("/\\");
+    if(file.compare((slash == std::string::npos) ? 0 : slash + 1, std::string::npos, framework) == 0)
+        return false;
+
+    static const char* const system[] = { "/usr/include/", "/usr/lib/", "/usr/local/include/", "/usr/local/lib/" };
+    for(auto&& directory : system)
+        if(file.compare(0, std::strlen(directory), directory) == 0)
+            return false;
+
+    if(sources.empty())
+        return true;
+    for(auto&& source : sources)
+        if(file.compare(0, source.size(), source) == 0)
+            return true;
+    return false;
+}
+
+inline void TestRunner::symbolize(const std::vector<std::uintptr_t>& addresses, std::map<std::uintptr_t, SourceLine>& lines)
+{
+    struct Mapping
+    {
+        std::uintptr_t start;
+        std::uintptr_t end;
+        std::string module;
+    };
+
+    // Executable mappings, and where each module's first page went
+    std::vector<Mapping> mappings;
+    std::map<std::string, std::uintptr_t> bases;
+    std::ifstream maps("/proc/self/maps");
+    std::string entry;
+    while(std::getline(maps, entry))
+    {
+        std::istringstream fields(entry);
+        std::string range, permissions, device, module;
+        unsigned long long offset, inode;
+        fields >> range >> permissions >> std::hex >> offset >> device >> std::dec >> inode >> module;
+        if(module.empty() || module[0] != '/')
+            continue;
+        Mapping mapping;
+        mapping.start = (std::uintptr_t)std::strtoull(range.c_str(), nullptr, 16);
+        mapping.end = (std::uintptr_t)std::strtoull(range.c_str() + range.find('-') + 1, nullptr, 16);
+        mapping.module = module;
+        if(offset == 0 && !bases.count(module))
+            bases[module] = mapping.start;
+        if(permissions.find('x') != std::string::npos)
+            mappings.push_back(mapping);
+    }
+
+    // Position independent modules are looked up relative to where they were loaded
+    std::map<std::string, std::vector<std::uintptr_t>> byModule;
+    for(auto&& address : addresses)
+    {
+        for(auto&& mapping : mappings)
+        {
+            if(address < mapping.start || address >= mapping.end || !bases.count(mapping.module))
+                continue;
+            byModule[mapping.module].push_back(address);
+            break;
+        }
+    }
+
+    const char* tool = std::getenv("SLIMTEST_ADDR2LINE");
+    const char* temporary = std::getenv("TMPDIR");
+    for(auto&& module : byModule)
+    {
+        const std::uintptr_t base = bases[module.first];
+        std::uint16_t type;
+        std::memcpy(&type, reinterpret_cast<const char*>(base) + 16, sizeof(type));
+        const std::uintptr_t offset = (type == 2) ? 0 : base;
+
+        std::string list = std::string(temporary ? temporary : "/tmp") + "/SlimTest.XXXXXX";
+        const int descriptor = mkstemp(&list[0]);
+        if(descriptor < 0)
+            continue;
+        std::ostringstream text;
+        text << std::hex;
+        for(auto&& address : module.second)
+            text << "0x" << address - offset << "\n";
+        const std::string written = text.str();
+        const bool ready = writeAll(descriptor, written.data(), written.size());
+        close(descriptor);
+
+        auto quote = [](const std::string& argument)
+        {
+            std::string quoted = "'";
+            for(auto&& character : argument)
+                quoted += (character == '\'') ? std::string("'\\''") : std::string(1, character);
+            return quoted + "'";
+        };
+        FILE* pipe = ready ? popen(((tool ? tool : "addr2line") + std::string(" -e ") + quote(module.first)
+            + " < " + quote(list)).c_str(), "r") : nullptr;
+        if(pipe)
+        {
+            char buffer[4096];
+            for(size_t index = 0; index < module.second.size() && std::fgets(buffer, sizeof(buffer), pipe); ++index)
+            {
+                // file:line, maybe followed by " (discriminator N)"
+                std::string place = buffer;
+                place = place.substr(0, place.find_first_of(" \n"));
+                const size_t colon = place.rfind(':');
+                const int line = (colon == std::string::npos) ? 0 : std::atoi(place.c_str() + colon + 1);
+                if(line > 0 && place.compare(0, 2, "??") != 0)
+                {
+                    SourceLine source = { place.substr(0, colon), line };
+                    lines[module.second[index]] = source;
+                }
+            }
+            pclose(pipe);
+        }
+        unlink(list.c_str());
+    }
+}
+
+// lcov test names are letters, digits and underscores
+inline std::string TestRunner::lcovName(const std::string& name)
+{
+    std::string plain = name;
+    for(auto&& character : plain)
+        if(!std::isalnum((unsigned char)character))
+            character = '_';
+    return plain;
+}
+#endif
+
+inline double TestRunner::cpuTime(bool process)
+{
+#if defined CLOCK_THREAD_CPUTIME_ID && defined CLOCK_PROCESS_CPUTIME_ID
+    timespec now;
+    clock_gettime(process ? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+#else
+    (void)process;
+    return 1e9 * std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Peak resident set size in kilobytes, or zero where it is not available
+inline std::int64_t TestRunner::peakMemory()
+{
+#ifdef SLIMTEST_WINDOWS
+    return 0;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+inline bool TestRunner::parseArguments(int argc, char* argv[], Options& options)
+{
+    bool jobsGiven = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string argument = argv[i];
+        if(argument.compare(0, 7, "--jobs=") == 0)
+        {
+            jobsGiven = true;
+            const long jobs = std::strtol(argument.c_str() + 7, nullptr, 10);
+            options.jobs = (jobs > 0) ? (size_t)jobs : std::thread::hardware_concurrency();
+            if(options.jobs == 0)
+                options.jobs = 1;
+        }
+#ifndef SLIMTEST_WINDOWS
+        else if(argument.compare(0, 10, "--isolate=") == 0)
+        {
+            const long processes = std::strtol(argument.c_str() + 10, nullptr, 10);
+            options.processes = (processes > 0) ? (size_t)processes : std::thread::hardware_concurrency();
+            if(options.processes == 0)
+                options.processes = 1;
+        }
+#endif
+        else if(argument.compare(0, 10, "--timeout=") == 0)
+        {
+            options.timeout = (unsigned)std::strtoul(argument.c_str() + 10, nullptr, 10);
+        }
+        else if(argument == "--benchmark")
+        {
+            options.benchmark = true;
+        }
+        else if(argument.compare(0, 20, "--benchmark-samples=") == 0)
+        {
+            const long samples = std::strtol(argument.c_str() + 20, nullptr, 10);
+            options.benchmarkSamples = (samples > 0) ? (size_t)samples : 1;
+        }
+        else if(argument.compare(0, 17, "--benchmark-time=") == 0)
+        {
+            const long time = std::strtol(argument.c_str() + 17, nullptr, 10);
+            options.benchmarkTime = (time > 0) ? (unsigned)time : 1;
+        }
+        else if(argument == "--profile" || argument.compare(0, 10, "--profile=") == 0)
+        {
+            const long count = (argument.size() > 10) ? std::strtol(argument.c_str() + 10, nullptr, 10) : 10;
+            options.profile = (count > 0) ? (size_t)count : 10;
+        }
+        else if(argument.compare(0, 17, "--reporter=junit:") == 0 || argument.compare(0, 17, "--reporter=jsonl:") == 0)
+        {
+            Options::ReporterOutput output = { argument.substr(11, 5), argument.substr(17) };
+            options.reporters.push_back(output);
+        }
+        else if(argument.compare(0, 10, "--include=") == 0)
+        {
+            options.includes.push_back(argument.substr(10));
+        }
+        else if(argument.compare(0, 10, "--exclude=") == 0)
+        {
+            options.excludes.push_back(argument.substr(10));
+        }
+        else if(argument == "--list")
+        {
+            options.list = true;
+        }
+        else if(argument.compare(0, 8, "--state=") == 0)
+        {
+            options.state = argument.substr(8);
+        }
+        else if(argument == "--changed")
+        {
+            options.changed = true;
+        }
+        else if(argument == "--order=registration" || argument == "--order=failed-first"
+            || argument == "--order=shortest-first")
+        {
+            options.order = argument.substr(8);
+        }
+        else if(argument == "--shuffle" || argument.compare(0, 10, "--shuffle=") == 0)
+        {
+            options.shuffle = true;
+            if(argument.size() > 10)
+                options.shuffleSeed = std::strtoull(argument.c_str() + 10, nullptr, 10);
+        }
+        else if(argument.compare(0, 9, "--repeat=") == 0)
+        {
+            const long count = std::strtol(argument.c_str() + 9, nullptr, 10);
+            options.repeat = (count > 0) ? (size_t)count : 1;
+        }
+        else if(argument == "--until-fail")
+        {
+            options.untilFail = true;
+        }
+        else if(argument == "--leak-sites")
+        {
+            options.leakSites = true;
+        }
+        else if(argument.compare(0, 7, "--fuzz=") == 0)
+        {
+            options.fuzz = argument.substr(7);
+        }
+        else if(argument.compare(0, 12, "--fuzz-time=") == 0)
+        {
+            const double seconds = std::strtod(argument.c_str() + 12, nullptr);
+            options.fuzzTime = (seconds > 0) ? seconds : 60.0;
+        }
+        else if(argument.compare(0, 15, "--fuzz-max-len=") == 0)
+        {
+            const long length = std::strtol(argument.c_str() + 15, nullptr, 10);
+            options.fuzzMaxLength = (length > 0) ? (size_t)length : 4096;
+        }
+        else if(argument.compare(0, 9, "--corpus=") == 0)
+        {
+            options.corpus = argument.substr(9);
+        }
+#ifdef SLIMTEST_HAS_COVERAGE
+        else if(argument.compare(0, 11, "--coverage=") == 0)
+        {
+            options.coverage = argument.substr(11);
+        }
+        else if(argument.compare(0, 18, "--coverage-source=") == 0)
+        {
+            options.coverageSources.push_back(argument.substr(18));
+        }
+#endif
+        else if(argument == "--fail-fast" || argument.compare(0, 12, "--fail-fast=") == 0)
+        {
+            const long count = (argument.size() > 12) ? std::strtol(argument.c_str() + 12, nullptr, 10) : 1;
+            options.failFast = (count > 0) ? (size_t)count : 1;
+        }
+        else if(argument.compare(0, 17, "--property-cases=") == 0)
+        {
+            const long cases = std::strtol(argument.c_str() + 17, nullptr, 10);
+            options.propertyCases = (cases > 0) ? (size_t)cases : 1;
+        }
+        else if(argument.compare(0, 16, "--property-seed=") == 0)
+        {
+            options.propertySeed = std::strtoull(argument.c_str() + 16, nullptr, 10);
+        }
+        else if(argument.compare(0, 17, "--benchmark-save=") == 0)
+        {
+            options.benchmarkSave = argument.substr(17);
+        }
+        else if(argument.compare(0, 20, "--benchmark-compare=") == 0)
+        {
+            options.benchmarkCompare = argument.substr(20);
+        }
+        else if(argument.compare(0, 18, "--benchmark-alpha=") == 0)
+        {
+            options.benchmarkAlpha = std::strtod(argument.c_str() + 18, nullptr);
+        }
+        else if(argument.compare(0, 22, "--benchmark-threshold=") == 0)
+        {
+            options.benchmarkThreshold = std::strtod(argument.c_str() + 22, nullptr);
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << argument << std::endl
+                << "Usage: " << argv[0] << " [options]" << std::endl
+                << "    --include=GLOB           Only run tests whose name matches GLOB (repeatable)" << std::endl
+                << "    --exclude=GLOB           Skip tests whose name matches GLOB (repeatable)" << std::endl
+                << "    --list                   List the selected tests instead of running them" << std::endl
+                << "    --state=FILE             Remember test outcomes and source file hashes in FILE" << std::endl
+                << "    --changed                Only run tests whose source file changed or that failed last" << std::endl
+                << "                             time, the failed ones first (state in SlimTest.state by default)" << std::endl
+                << "    --order=ORDER            registration, failed-first or shortest-first (uses the state)" << std::endl
+                << "    --fail-fast[=K]          Stop starting tests once K tests failed (default 1)" << std::endl
+                << "    --shuffle[=SEED]         Run the tests in a random order, reproducible with SEED" << std::endl
+                << "    --repeat=N               Run the selected tests N times" << std::endl
+                << "    --until-fail             Repeat the selected tests until one fails (at most --repeat times)" << std::endl
+                << "    --jobs=N                 Run tests on N worker threads (0 for one per core)" << std::endl
+                << "    --isolate=N              Run tests in N forked worker processes (0 for one per core)" << std::endl
+                << "    --timeout=MS             Fail a test running longer than MS and end the run, or with" << std::endl
+                << "                             --isolate only its worker (default budget per test)" << std::endl
+                << "    --profile[=N]            List the N slowest and most allocating tests (default 10)" << std::endl
+                << "    --leak-sites             Name where leaked blocks were allocated (SLIMTEST_TRACK_LEAKS)" << std::endl
+#ifdef SLIMTEST_HAS_COVERAGE
+                << "    --coverage=FILE          Write the lines each test reached to FILE as lcov (SLIMTEST_COVERAGE)," << std::endl
+                << "                             running the tests one at a time" << std::endl
+                << "    --coverage-source=PREFIX Only cover source files whose path starts with PREFIX (repeatable)" << std::endl
+#endif
+                << "    --property-cases=N       Values each property test is checked against (default 10000)" << std::endl
+                << "    --property-seed=S        Seed the property test values, as printed by a failure" << std::endl
+                << "    --fuzz=GLOB              Fuzz the fuzz tests matching GLOB, in one process per core or --jobs" << std::endl
+                << "    --fuzz-time=S            Seconds spent fuzzing each fuzz test (default 60)" << std::endl
+                << "    --fuzz-max-len=N         Longest input generated while fuzzing (default 4096)" << std::endl
+                << "    --corpus=DIR             Inputs of the fuzz tests, one directory per test (default SlimTest.corpus)" << std::endl
+                << "    --reporter=junit:FILE    Stream results to FILE as JUnit XML" << std::endl
+                << "    --reporter=jsonl:FILE    Stream results to FILE as JSON Lines" << std::endl
+                << "    --benchmark              Run the registered benchmarks instead of the tests" << std::endl
+                << "    --benchmark-samples=N    Number of timed samples per benchmark (default 100)" << std::endl
+                << "    --benchmark-time=MS      Time spent sampling each benchmark (default 500)" << std::endl
+                << "    --benchmark-save=FILE    Write the benchmark samples to FILE as a baseline" << std::endl
+                << "    --benchmark-compare=FILE Fail benchmarks that are significantly slower than FILE" << std::endl
+                << "    --benchmark-alpha=P      Significance level of the comparison (default 0.01)" << std::endl
+                << "    --benchmark-threshold=N  Ignore slowdowns of less than N percent (default 5)" << std::endl;
+            return false;
+        }
+    }
+    // Fuzzing forks its own workers, one per core unless --jobs says otherwise
+    if(!options.fuzz.empty())
+    {
+        options.processes = 0;
+        if(!jobsGiven)
+            options.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+#ifdef SLIMTEST_HAS_COVERAGE
+    // Every test is charged with what the process reached while it ran
+    if(!options.coverage.empty())
+    {
+        options.jobs = 1;
+        options.processes = 0;
+    }
+#endif
+    return true;
+}
+
+inline TestRunner::Registration::Registration(const char* names, const char* file, int line,
+    void (* const* functions)(), size_t count, FixtureSlot* fixture)
+    : names(names), file(file), line(line), functions(functions), count(count), fixture(fixture),
+    benchmark(nullptr), timeout(0), next(nullptr)
+{
+    link();
+}
+
+inline TestRunner::Registration::Registration(const char* name, void (*benchmark)(size_t))
+    : names(name), file(""), line(0), functions(nullptr), count(0), fixture(nullptr), benchmark(benchmark),
+    timeout(0), next(nullptr)
+{
+    link();
+}
+
+inline TestRunner::Registration::Registration(const char* name, unsigned timeout)
+    : names(name), file(""), line(0), functions(nullptr), count(0), fixture(nullptr), benchmark(nullptr),
+    timeout(timeout), next(nullptr)
+{
+    link();
+}
+
+// Registrations run during static initialization, so the list is kept in constant-initialized
+// pointers rather than in the singleton
+inline void TestRunner::Registration::link()
+{
+    Registration*& last = lastRegistration();
+    if(last)
+        last->next = this;
+    else
+        registrations() = this;
+    last = this;
+}
+
+inline TestRunner::Registration*& TestRunner::registrations()
+{
+    static Registration* first = nullptr;
+    return first;
+}
+
+inline TestRunner::Registration*& TestRunner::lastRegistration()
+{
+    static Registration* last = nullptr;
+    return last;
+}
+
+inline void TestRunner::registerTests(std::initializer_list<void (*)()> functions)
+{
+    // Registered at run time, so these live until exit like the macros' statics do
+    typedef void (*Function)();
+    Function* copy = new Function[functions.size()];
+    std::copy(functions.begin(), functions.end(), copy);
+    new Registration("", "", 0, copy, functions.size());
+}
+
+inline void TestRunner::registerBenchmark(const char* name, void (*benchmark)(size_t))
+{
+    new Registration(name, benchmark);
+}
+
+// Turns the registrations made since the last run into test cases and benchmarks
+inline void TestRunner::discover()
+{
+    const Registration* first = discovered ? discovered->next : registrations();
+    size_t tests = testCases.size();
+    for(const Registration* registration = first; registration; registration = registration->next)
+        tests += registration->count;
+    testCases.reserve(tests);
+    testIndex.reserve(tests);
+
+    for(const Registration* registration = first; registration; registration = registration->next)
+    {
+        if(registration->benchmark)
+        {
+            Benchmark entry = { registration->names, registration->benchmark };
+            benchmarks.push_back(entry);
+        }
+        else if(registration->timeout)
+            timeouts[registration->names] = registration->timeout;
+        else
+            discoverTests(*registration);
+        discovered = registration;
+    }
+
+    // A timeout may be set before or after its test is registered
+    for(auto&& timeout : timeouts)
+    {
+        std::unordered_map<std::string, size_t>::const_iterator found = testIndex.find(timeout.first);
+        if(found != testIndex.end())
+            testCases[found->second].timeout = timeout.second;
+    }
+}
+
+// names is the stringified argument list of the registering macro. Arguments that are plain
+// identifiers name their test; anything else is named after where it was registered.
+inline void TestRunner::discoverTests(const Registration& registration)
+{
+    const char* position = registration.names;
+    const char* file = registration.file;
+    const int line = registration.line;
+    for(size_t argument = 0; argument < registration.count; ++argument)
+    {
+        std::string name;
+        int depth = 0;
+        for(; *position && (depth > 0 || *position != ','); ++position)
+        {
+            if(*position == '(' || *position == '[' || *position == '{')
+                ++depth;
+            else if(*position == ')' || *position == ']' || *position == '}')
+                --depth;
+            name += *position;
+        }
+        if(*position == ',')
+            ++position;
+
+        name.erase(0, name.find_first_not_of(" \t\r\n"));
+        name.erase(name.find_last_not_of(" \t\r\n") + 1);
+        const bool identifier = !name.empty() && !std::isdigit((unsigned char)name[0])
+            && name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_:") == std::string::npos;
+        if(!identifier)
+        {
+            std::ostringstream generated;
+            if(*file)
+                generated << file << ":" << line;
+            else
+                generated << "test " << testCases.size() + 1;
+            if(registration.count > 1)
+                generated << "#" << argument + 1;
+            name = generated.str();
+        }
+
+        // Keep every name unique so it can be used to select exactly one test
+        std::string unique = name;
+        for(size_t duplicate = 2; testIndex.count(unique); ++duplicate)
+        {
+            std::ostringstream numbered;
+            numbered << name << "#" << duplicate;
+            unique = numbered.str();
+        }
+
+        TestCase test = { unique, file, line, registration.functions[argument], registration.fixture, 0,
+            { file, line, "test function returns", "no exception but one escaped" },
+            { file, line, "test function frees what it allocates", "every block freed once, by the matching delete" } };
+        testIndex[unique] = testCases.size();
+        testCases.push_back(test);
+    }
+}
+
+inline void TestRunner::incrementAssertionCount()
+{
+    ThreadState& state = threadState();
+    state.totalAssertions.store(state.totalAssertions.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    if(SLIMTEST_UNLIKELY(state.stressing != nullptr))
+        perturb(*state.stressing);
+}
+
+inline void TestRunner::incrementAssertionCount(const Assertion& assertion)
+{
+    ThreadState& state = threadState();
+    state.totalAssertions.store(state.totalAssertions.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    state.lastAssertion.store(&assertion, std::memory_order_relaxed);
+    if(SLIMTEST_UNLIKELY(state.stressing != nullptr))
+        perturb(*state.stressing);
+}
+
+inline void TestRunner::incrementFailedAssertions()
+{
+    std::atomic<size_t>& counter = threadState().failedAssertions;
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Only valid inside a catch block, names what it caught
+inline std::string TestRunner::describeException()
+{
+    try
+    {
+        throw;
+    }
+    catch(const std::exception& exception)
+    {
+        return std::string("\"") + exception.what() + "\"";
+    }
+    catch(...)
+    {
+        return "an exception not derived from std::exception";
+    }
+}
+
+inline void TestRunner::recordFailure(const Assertion& assertion, const std::string& values)
+{
+    ThreadState& state = threadState();
+    Failure failure = { &assertion, values };
+    // Kept until the test is collected, so not the test's to free
+    Ledger* charged = state.charged;
+    state.charged = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state.failuresMutex);
+        state.failures.push_back(failure);
+        state.failedAssertions.store(state.failedAssertions.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+    }
+    state.charged = charged;
+}
+
+template<typename Lhs, typename Rhs>
+void TestRunner::fail(const Assertion& assertion, const Lhs& lhs, const Rhs& rhs)
+{
+    std::ostringstream values;
+    values << lhs << ", " << rhs;
+    recordFailure(assertion, values.str());
+}
+
+template<typename Value>
+void TestRunner::fail(const Assertion& assertion, const Value& value)
+{
+    std::ostringstream values;
+    values << value;
+    recordFailure(assertion, values.str());
+}
+
+template<typename Type>
+TestRunner::FixtureSlot& TestRunner::fixtureSlot()
+{
+    static FixtureSlot slot(&createFixture<Type>);
+    return slot;
+}
+
+template<typename Type>
+Type& TestRunner::fixture()
+{
+    return static_cast<Type&>(*fixtureSlot<Type>().instance);
+}
+
+template<typename Type>
+TestRunner::Fixture* TestRunner::createFixture()
+{
+    return new Type();
+}
+
+inline unsigned TestRunner::testTimeout(size_t index) const
+{
+    return testCases[index].timeout ? testCases[index].timeout : defaultTimeout;
+}
+
+inline std::int64_t TestRunner::steadyMilliseconds()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Called on the watchdog thread while the test is still running. Its thread cannot be stopped,
+// so the process ends here: a worker process reports the test and exits, anything else reports
+// it, closes the reporters and exits with the number of failed tests.
+inline void TestRunner::timedOut(Context& context)
+{
+    TestResult result;
+    result.name = testName(context.running);
+    result.status = TimedOut;
+    result.profile.index = context.running;
+    result.profile.wallTime = context.budget;
+
+    std::ostringstream detail;
+    detail << "after " << context.budget << " ms, ";
+    const Assertion* last = context.runner->lastAssertion.load(std::memory_order_relaxed);
+    if(last)
+        detail << "last assertion reached: " << last->expression << " at " << last->file << " " << last->line;
+    else
+        detail << "before reaching any assertion";
+    result.detail = detail.str();
+
+#ifndef SLIMTEST_WINDOWS
+    if(workerOutput >= 0)
+    {
+        WorkerResult sent;
+        sent.index = context.running;
+        sent.status = TimedOut;
+        sent.assertions = 0;
+        sent.detail = result.detail.size();
+        sent.length = 0;
+        sent.profile = result.profile;
+        std::cout.flush();
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if(writeAll(workerOutput, &sent, sizeof(sent)))
+            writeAll(workerOutput, result.detail.data(), result.detail.size());
+        _exit(0);
+    }
+#endif
+
+    finish(result);
+    std::lock_guard<std::mutex> lock(reportMutex);
+    saveRunState();
+    for(auto&& reporter : activeReporters)
+        reporter->runFinished(finishedTests - failedTests, startedRuns);
+    if(sink)
+        sink->flush();
+    std::cout.flush();
+    std::_Exit((int)failedTests);
+}
+
+// Fixtures whose last user never ran here, e.g. in an --isolate worker
+inline void TestRunner::releaseFixtures()
+{
+    for(auto&& test : testCases)
+    {
+        if(test.fixture && test.fixture->instance)
+        {
+            delete test.fixture->instance;
+            test.fixture->instance = nullptr;
+        }
+    }
+}
+
+inline TestRunner::Checkpoint TestRunner::checkpoint()
+{
+    ThreadState& state = threadState();
+    std::lock_guard<std::mutex> lock(state.failuresMutex);
+    Checkpoint checkpoint = { state.failedAssertions.load(std::memory_order_relaxed), state.failures.size() };
+    return checkpoint;
+}
+
+inline bool TestRunner::failedSince(const Checkpoint& checkpoint)
+{
+    return threadState().failedAssertions.load(std::memory_order_relaxed) != checkpoint.failed;
+}
+
+inline void TestRunner::rollback(const Checkpoint& checkpoint)
+{
+    ThreadState& state = threadState();
+    std::lock_guard<std::mutex> lock(state.failuresMutex);
+    state.failedAssertions.store(checkpoint.failed, std::memory_order_relaxed);
+    if(state.failures.size() > checkpoint.failures)
+        state.failures.resize(checkpoint.failures);
+}
+
+inline void* TestRunner::allocate(size_t size)
+{
+    void* memory = std::malloc(size ? size : 1);
+    if(!memory)
+        throw std::bad_alloc();
+
+    ThreadState& state = threadState();
+    state.allocations.store(state.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    state.allocatedBytes.store(state.allocatedBytes.load(std::memory_order_relaxed) + size,
+        std::memory_order_relaxed);
+    return memory;
+}
+
+inline void TestRunner::deallocate(void* memory)
+{
+    std::free(memory);
+}
+
+inline void* TestRunner::allocateTracked(size_t size, bool array, void* site)
+{
+    if(size > (size_t)-1 - blockOffset)
+        throw std::bad_alloc();
+    BlockHeader* header = static_cast<BlockHeader*>(std::malloc(blockOffset + size));
+    if(!header)
+        throw std::bad_alloc();
+
+    ThreadState& state = threadState();
+    state.allocations.store(state.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    state.allocatedBytes.store(state.allocatedBytes.load(std::memory_order_relaxed) + size,
+        std::memory_order_relaxed);
+
+    if(!blockTable().record(reinterpret_cast<std::uintptr_t>(header), array ? LiveArray : LiveBlock))
+    {
+        std::free(header);
+        throw std::bad_alloc();
+    }
+
+    Ledger* ledger = state.charged;
+    header->size = size;
+    header->ledger = ledger;
+    header->site = site;
+    if(ledger)
+    {
+        if(leakSites().load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(ledger->mutex);
+            charge(*ledger, false, 1, size);
+            header->epoch = ledger->epoch.load(std::memory_order_relaxed);
+            header->previous = nullptr;
+            header->next = ledger->live;
+            if(ledger->live)
+                ledger->live->previous = header;
+            ledger->live = header;
+        }
+        else
+        {
+            charge(*ledger, ledger == &state.ledger, 1, size);
+            header->epoch = ledger->epoch.load(std::memory_order_relaxed);
+        }
+    }
+    return reinterpret_cast<char*>(header) + blockOffset;
+}
+
+inline void TestRunner::deallocateTracked(void* memory, bool array, void* site)
+{
+    if(!memory)
+        return;
+
+    // A pointer the table does not know, such as a block another module's operator new
+    // allocated, has no header of ours and is handed to free as it is
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(memory) - blockOffset;
+    const std::uint64_t tag = blockTable().release(address);
+    if(SLIMTEST_UNLIKELY(tag == 0))
+    {
+        std::free(memory);
+        return;
+    }
+    if(SLIMTEST_UNLIKELY(tag == FreedBlock))
+    {
+        // Freed already; leaking it beats corrupting the heap
+        misusedBlock(site);
+        return;
+    }
+    if(SLIMTEST_UNLIKELY((tag == LiveArray) != array))
+        misusedBlock(site);
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(address);
+
+    Ledger* ledger = header->ledger;
+    if(ledger)
+    {
+        if(leakSites().load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(ledger->mutex);
+            if(header->epoch == ledger->epoch.load(std::memory_order_relaxed))
+            {
+                if(header->previous)
+                    header->previous->next = header->next;
+                else
+                    ledger->live = header->next;
+                if(header->next)
+                    header->next->previous = header->previous;
+                charge(*ledger, false, (size_t)-1, 0 - header->size);
+            }
+        }
+        else if(header->epoch == ledger->epoch.load(std::memory_order_relaxed))
+        {
+            // Counts wrap around, what one thread frees of another's blocks still adds up
+            charge(*ledger, ledger == &threadState().ledger, (size_t)-1, 0 - header->size);
+        }
+    }
+    std::free(header);
+}
+
+inline TestRunner::BlockTable& TestRunner::blockTable()
+{
+    // Never destroyed, static destructors still free blocks after main returns
+    static BlockTable* const table = []()
+    {
+        void* memory = std::malloc(sizeof(BlockTable));
+        if(!memory)
+            std::abort();
+        BlockTable* created = new(memory) BlockTable();
+#ifndef SLIMTEST_WINDOWS
+        // A child forked while another thread holds a shard would deadlock on its first new
+        pthread_atfork([]() { blockTable().lockAll(); }, []() { blockTable().unlockAll(); },
+            []() { blockTable().unlockAll(); });
+#endif
+        return created;
+    }();
+    return *table;
+}
+
+inline bool TestRunner::BlockTable::record(std::uintptr_t header, std::uint64_t tag)
+{
+    const std::uint64_t hashed = hash(header);
+    Shard& shard = shards[hashed % shardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if((shard.used + 1) * 2 > shard.capacity && !grow(shard))
+        return false;
+    Entry& entry = find(shard, header, hashed);
+    if(entry.header == 0)
+    {
+        entry.header = header;
+        ++shard.used;
+    }
+    entry.tag = tag;
+    return true;
+}
+
+// The tag header had, 0 for one the table never saw. A live block is marked freed.
+inline std::uint64_t TestRunner::BlockTable::release(std::uintptr_t header)
+{
+    const std::uint64_t hashed = hash(header);
+    Shard& shard = shards[hashed % shardCount];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(!shard.entries)
+        return 0;
+    Entry& entry = find(shard, header, hashed);
+    if(entry.header == 0)
+        return 0;
+    const std::uint64_t tag = entry.tag;
+    entry.tag = FreedBlock;
+    return tag;
+}
+
+inline void TestRunner::BlockTable::lockAll()
+{
+    for(auto&& shard : shards)
+        shard.mutex.lock();
+}
+
+inline void TestRunner::BlockTable::unlockAll()
+{
+    for(auto&& shard : shards)
+        shard.mutex.unlock();
+}
+
+inline std::uint64_t TestRunner::BlockTable::hash(std::uintptr_t header)
+{
+    std::uint64_t value = header;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return value;
+}
+
+// The entry holding header, or the empty one it goes into
+inline TestRunner::BlockTable::Entry& TestRunner::BlockTable::find(const Shard& shard, std::uintptr_t header,
+    std::uint64_t hashed)
+{
+    size_t slot = (size_t)(hashed / shardCount) & (shard.capacity - 1);
+    while(shard.entries[slot].header != 0 && shard.entries[slot].header != header)
+        slot = (slot + 1) & (shard.capacity - 1);
+    return shard.entries[slot];
+}
+
+inline bool TestRunner::BlockTable::grow(Shard& shard)
+{
+    const size_t capacity = shard.capacity ? shard.capacity * 2 : 1024;
+    Entry* entries = static_cast<Entry*>(std::calloc(capacity, sizeof(Entry)));
+    if(!entries)
+        return false;
+    Shard grown;
+    grown.entries = entries;
+    grown.capacity = capacity;
+    for(size_t i = 0; i < shard.capacity; ++i)
+    {
+        if(shard.entries[i].header != 0)
+            find(grown, shard.entries[i].header, hash(shard.entries[i].header)) = shard.entries[i];
+    }
+    std::free(shard.entries);
+    shard.entries = entries;
+    shard.capacity = capacity;
+    return true;
+}
+
+inline std::atomic<bool>& TestRunner::leakSites()
+{
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+inline void TestRunner::charge(Ledger& ledger, bool owner, size_t blocks, size_t bytes)
+{
+    if(owner)
+    {
+        ledger.ownerBlocks.store(ledger.ownerBlocks.load(std::memory_order_relaxed) + blocks, std::memory_order_relaxed);
+        ledger.ownerBytes.store(ledger.ownerBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    }
+    else
+    {
+        ledger.blocks.fetch_add(blocks, std::memory_order_relaxed);
+        ledger.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+inline void TestRunner::misusedBlock(void* site)
+{
+    Ledger* ledger = threadState().charged;
+    if(ledger && ledger->misuses.fetch_add(1, std::memory_order_relaxed) == 0)
+        ledger->misuseSite.store(site, std::memory_order_relaxed);
+}
+
+inline void TestRunner::openLedger(Ledger& ledger)
+{
+    std::lock_guard<std::mutex> lock(ledger.mutex);
+    ledger.epoch.fetch_add(1, std::memory_order_relaxed);
+    ledger.blocks.store(0, std::memory_order_relaxed);
+    ledger.bytes.store(0, std::memory_order_relaxed);
+    ledger.ownerBlocks.store(0, std::memory_order_relaxed);
+    ledger.ownerBytes.store(0, std::memory_order_relaxed);
+    ledger.misuses.store(0, std::memory_order_relaxed);
+    ledger.misuseSite.store(nullptr, std::memory_order_relaxed);
+    ledger.live = nullptr;
+}
+
+inline void TestRunner::closeLedger(const TestCase& test, Ledger& ledger)
+{
+    std::lock_guard<std::mutex> lock(ledger.mutex);
+    const size_t blocks = ledger.blocks.load(std::memory_order_relaxed) + ledger.ownerBlocks.load(std::memory_order_relaxed);
+    const size_t bytes = ledger.bytes.load(std::memory_order_relaxed) + ledger.ownerBytes.load(std::memory_order_relaxed);
+    const size_t misuses = ledger.misuses.load(std::memory_order_relaxed);
+    // Whatever is still live now belongs to no test
+    ledger.epoch.fetch_add(1, std::memory_order_relaxed);
+    if(blocks == 0 && misuses == 0)
+        return;
+
+    std::ostringstream values;
+    if(blocks > 0)
+    {
+        values << blocks << (blocks == 1 ? " block" : " blocks") << " of "
+            << bytes << " bytes not freed";
+        if(ledger.live)
+        {
+            const size_t shown = 5;
+            size_t listed = 0;
+            values << ", allocated at";
+            for(const BlockHeader* header = ledger.live; header && listed < shown; header = header->next, ++listed)
+                values << (listed ? ", " : " ") << header->site << " (" << header->size << " bytes)";
+            if(blocks > listed)
+                values << ", ...";
+        }
+        else
+        {
+            values << ", --leak-sites shows where";
+        }
+    }
+    if(misuses > 0)
+    {
+        values << (blocks > 0 ? "; " : "") << misuses << (misuses == 1 ? " delete" : " deletes")
+            << " of a block that was freed already or came from the other form of new, first at "
+            << ledger.misuseSite.load(std::memory_order_relaxed);
+    }
+    ledger.live = nullptr;
+    recordFailure(test.leaked, values.str());
+}
+
+inline TestRunner::Context* TestRunner::currentTest()
+{
+    return threadState().owner;
+}
+
+inline TestRunner::ThreadScope::ThreadScope(Context* test)
+    : previous(threadState().owner)
+{
+    ThreadState& state = threadState();
+    std::lock_guard<std::mutex> lock(collectMutex());
+    if(previous)
+        fold(state, *previous);
+    state.owner = test;
+    state.charged = (test && test->runner) ? &test->runner->ledger : nullptr;
+}
+
+inline TestRunner::ThreadScope::~ThreadScope()
+{
+    // Hand over the counts now, the thread may outlive its binding
+    ThreadState& state = threadState();
+    std::lock_guard<std::mutex> lock(collectMutex());
+    Context* test = state.owner;
+    if(test)
+        fold(state, *test);
+    state.owner = previous;
+    state.charged = (previous && previous->runner) ? &previous->runner->ledger : nullptr;
+}
+
+inline void TestRunner::collect(Context& context)
+{
+    std::lock_guard<std::mutex> lock(collectMutex());
+    for(ThreadState* state = threadStates().load(); state; state = state->next)
+    {
+        Context* owner = state->owner;
+        if(owner != &context && (owner || !context.sole))
+            continue;
+
+        fold(*state, context);
+        if(state->status == ThreadRetired)
+            state->status = ThreadFree;
+    }
+}
+
+inline void TestRunner::fold(ThreadState& state, Context& context)
+{
+    // A failure is counted and recorded under the same lock, so the two stay in step
+    std::lock_guard<std::mutex> lock(state.failuresMutex);
+    const size_t total = state.totalAssertions.load(std::memory_order_relaxed);
+    const size_t failed = state.failedAssertions.load(std::memory_order_relaxed);
+    context.totalAssertions += total - state.collectedTotal;
+    context.failedAssertions += failed - state.collectedFailed;
+    state.collectedTotal = total;
+    state.collectedFailed = failed;
+
+    const size_t allocations = state.allocations.load(std::memory_order_relaxed);
+    const size_t allocatedBytes = state.allocatedBytes.load(std::memory_order_relaxed);
+    context.profile.allocations += allocations - state.collectedAllocations;
+    context.profile.allocatedBytes += allocatedBytes - state.collectedBytes;
+    state.collectedAllocations = allocations;
+    state.collectedBytes = allocatedBytes;
+
+    if(!state.failures.empty())
+    {
+        context.failures.insert(context.failures.end(), state.failures.begin(), state.failures.end());
+        state.failures.clear();
+    }
+}
+
+inline TestRunner::ThreadState& TestRunner::threadState()
+{
+    ThreadState*& state = threadStateSlot();
+    if(!state)
+        state = acquireThreadState();
+    return *state;
+}
+
+inline TestRunner::ThreadState*& TestRunner::threadStateSlot()
+{
+    static SLIMTEST_THREAD_LOCAL ThreadState* state = nullptr;
+    return state;
+}
+
+inline TestRunner::ThreadState* TestRunner::acquireThreadState()
+{
+#ifdef SLIMTEST_THREAD_EXIT
+    // Without it the states of exited threads are not reused
+    static SLIMTEST_THREAD_LOCAL ThreadStateRelease release;
+    (void)release;
+#endif
+
+    std::atomic<ThreadState*>& head = threadStates();
+    for(ThreadState* state = head.load(); state; state = state->next)
+    {
+        int expected = ThreadFree;
+        if(state->status.compare_exchange_strong(expected, ThreadActive))
+        {
+            state->owner = nullptr;
+            state->charged = nullptr;
+            state->executing = nullptr;
+            return state;
+        }
+    }
+
+    // Allocated with malloc so a hooked operator new cannot recurse back in here
+    void* memory = std::malloc(sizeof(ThreadState));
+    if(!memory)
+        throw std::bad_alloc();
+    ThreadState* state = new(memory) ThreadState();
+    ThreadState* next = head.load();
+    do
+    {
+        state->next = next;
+    } while(!head.compare_exchange_weak(next, state));
+    return state;
+}
+
+inline TestRunner::ThreadStateRelease::~ThreadStateRelease()
+{
+    ThreadState*& state = threadStateSlot();
+    if(!state)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(collectMutex());
+        Context* owner = state->owner;
+        if(owner)
+            fold(*state, *owner);
+        state->owner = nullptr;
+        state->status = ThreadRetired;
+    }
+    state = nullptr;
+}
+
+inline std::atomic<TestRunner::ThreadState*>& TestRunner::threadStates()
+{
+    static std::atomic<ThreadState*> head(nullptr);
+    return head;
+}
+
+inline std::mutex& TestRunner::collectMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline void TestRunner::Context::reset()
+{
+    failedAssertions = 0;
+    totalAssertions = 0;
+    profile = Profile();
+    failures.clear();
+}
+
+inline TestRunner::Watchdog::Watchdog()
+    : stopping(false)
+{
+    thread = std::thread(&Watchdog::run, this);
+}
+
+inline TestRunner::Watchdog::~Watchdog()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+inline void TestRunner::Watchdog::watch(Context& context)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    contexts.push_back(&context);
+}
+
+inline void TestRunner::Watchdog::unwatch(Context& context)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    contexts.erase(std::remove(contexts.begin(), contexts.end(), &context), contexts.end());
+}
+
+// Deadlines are published without locking, so they are polled rather than waited for
+inline void TestRunner::Watchdog::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!stopping)
+    {
+        std::int64_t wait = 50;
+        const std::int64_t now = steadyMilliseconds();
+        for(auto&& context : contexts)
+        {
+            std::int64_t deadline = context->deadline.load(std::memory_order_acquire);
+            if(deadline <= 0)
+                continue;
+            if(deadline <= now)
+            {
+                if(context->deadline.compare_exchange_strong(deadline, -1))
+                    testRunner().timedOut(*context);
+                continue;
+            }
+            if(deadline - now < wait)
+                wait = deadline - now;
+        }
+        wake.wait_for(lock, std::chrono::milliseconds(wait));
+    }
+}
+
+inline TestRunner::OutputSink::OutputSink()
+    : enqueued(0)
+    , dequeued(0)
+    , requested(0)
+    , flushed(0)
+    , staged(0)
+    , stopping(false)
+{
+    for(size_t i = 0; i < capacity; ++i)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+        cells[i].text = nullptr;
+    }
+    std::cout.flush();
+    stream = std::cout.rdbuf(&capture);
+    thread = std::thread(&OutputSink::run, this);
+}
+
+inline TestRunner::OutputSink::~OutputSink()
+{
+    std::cout.rdbuf(stream);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+// Only waits when the writer is a whole ring behind
+inline void TestRunner::OutputSink::post(std::string* text)
+{
+    size_t position = enqueued.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Cell& cell = cells[position & (capacity - 1)];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if(sequence == position)
+        {
+            if(enqueued.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.text = text;
+                cell.sequence.store(position + 1, std::memory_order_release);
+                break;
+            }
+        }
+        else if(sequence < position)
+        {
+            wake.notify_one();
+            std::this_thread::yield();
+            position = enqueued.load(std::memory_order_relaxed);
+        }
+        else
+            position = enqueued.load(std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+// Waits until everything posted so far is through the stream, for a fork or a hasty exit
+inline void TestRunner::OutputSink::flush()
+{
+    const size_t target = enqueued.load(std::memory_order_acquire);
+    if(flushed.load(std::memory_order_acquire) >= target)
+        return;
+    std::unique_lock<std::mutex> lock(mutex);
+    if(requested < target)
+        requested = target;
+    wake.notify_one();
+    drained.wait(lock, [this, target] { return flushed.load(std::memory_order_relaxed) >= target; });
+}
+
+// In a forked child, which has no writer: std::cout gets its own buffer back
+inline void TestRunner::OutputSink::abandon()
+{
+    std::cout.rdbuf(stream);
+}
+
+#ifndef SLIMTEST_WINDOWS
+// For a signal handler: writes out what is staged and committed to the ring, without
+// locking or allocating. Best effort, as the writer may be busy with the same text.
+inline void TestRunner::OutputSink::salvage() const
+{
+    writeAll(STDOUT_FILENO, staging, staged.load(std::memory_order_acquire));
+    size_t position = dequeued.load(std::memory_order_acquire);
+    for(size_t i = 0; i < capacity; ++i, ++position)
+    {
+        const Cell& cell = cells[position & (capacity - 1)];
+        if(cell.sequence.load(std::memory_order_acquire) != position + 1)
+            break;
+        writeAll(STDOUT_FILENO, cell.text->data(), cell.text->size());
+    }
+}
+#endif
+
+inline bool TestRunner::OutputSink::pop(std::string*& text)
+{
+    const size_t position = dequeued.load(std::memory_order_relaxed);
+    Cell& cell = cells[position & (capacity - 1)];
+    if(cell.sequence.load(std::memory_order_acquire) != position + 1)
+        return false;
+    text = cell.text;
+    cell.sequence.store(position + capacity, std::memory_order_release);
+    dequeued.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool TestRunner::OutputSink::pending() const
+{
+    const size_t position = dequeued.load(std::memory_order_relaxed);
+    return cells[position & (capacity - 1)].sequence.load(std::memory_order_acquire) == position + 1;
+}
+
+inline void TestRunner::OutputSink::stage(const std::string& text)
+{
+    size_t used = staged.load(std::memory_order_relaxed);
+    if(used + text.size() > stagingSize)
+    {
+        handOver();
+        used = 0;
+    }
+    if(text.size() > stagingSize)
+    {
+        stream->sputn(text.data(), (std::streamsize)text.size());
+        return;
+    }
+    std::memcpy(staging + used, text.data(), text.size());
+    staged.store(used + text.size(), std::memory_order_release);
+}
+
+inline void TestRunner::OutputSink::handOver()
+{
+    stream->sputn(staging, (std::streamsize)staged.load(std::memory_order_relaxed));
+    stream->pubsync();
+    staged.store(0, std::memory_order_release);
+}
+
+// Posts notify without locking, so a missed wakeup is caught by the timed wait
+inline void TestRunner::OutputSink::run()
+{
+    bool last = false;
+    while(!last)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(10), [this] {
+                return stopping || pending() || requested > flushed.load(std::memory_order_relaxed);
+            });
+            last = stopping;
+        }
+
+        std::string* text;
+        while(pop(text))
+        {
+            stage(*text);
+            delete text;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(last || requested > flushed.load(std::memory_order_relaxed))
+        {
+            handOver();
+            flushed.store(dequeued.load(std::memory_order_relaxed), std::memory_order_release);
+            drained.notify_all();
+        }
+    }
+}
+
+inline TestRunner::OutputSink::Capture::int_type TestRunner::OutputSink::Capture::overflow(int_type character)
+{
+    if(traits_type::eq_int_type(character, traits_type::eof()))
+        return traits_type::not_eof(character);
+    output(std::string(1, traits_type::to_char_type(character)));
+    return character;
+}
+
+inline std::streamsize TestRunner::OutputSink::Capture::xsputn(const char* text, std::streamsize size)
+{
+    output(std::string(text, (size_t)size));
+    return size;
+}
+
+inline void TestRunner::WorkQueue::push(size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    indices.push_back(index);
+}
+
+inline bool TestRunner::WorkQueue::pop(size_t& index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(indices.empty())
+        return false;
+    index = indices.back();
+    indices.pop_back();
+    return true;
+}
+
+inline bool TestRunner::WorkQueue::steal(size_t& index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(indices.empty())
+        return false;
+    index = indices.front();
+    indices.pop_front();
+    return true;
+}
+
+inline TestRunner& TestRunner::testRunner()
+{
+    static TestRunner singleton;
+    return singleton;
+}
+
+namespace SlimTest
+{
+    // Forces value to be computed and kept, without otherwise affecting the generated code
+    template<typename Value>
+    inline void doNotOptimize(const Value& value)
+    {
+#if defined __GNUC__ || defined __clang__
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const void* volatile sink;
+        sink = &value;
+#endif
+    }
+
+    // Forces pending writes to memory, so stores the benchmark body makes are not elided
+    inline void clobberMemory()
+    {
+#if defined __GNUC__ || defined __clang__
+        asm volatile("" : : : "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    // fabs() needs no blend instructions, so it vectorizes with plain SSE2 as well
+    template<typename Value>
+    inline Value absoluteDifference(Value lhs, Value rhs, std::true_type floating)
+    {
+        (void)floating;
+        return std::fabs(lhs - rhs);
+    }
+
+    template<typename Value>
+    inline Value absoluteDifference(Value lhs, Value rhs, std::false_type floating)
+    {
+        (void)floating;
+        return (lhs < rhs) ? rhs - lhs : lhs - rhs;
+    }
+
+    // Whether lhs and rhs are at most tolerance apart. NaN is near nothing, not even NaN.
+    template<typename Lhs, typename Rhs, typename Tolerance>
+    inline bool withinAbsolute(const Lhs& lhs, const Rhs& rhs, const Tolerance& tolerance)
+    {
+        typedef typename std::common_type<Lhs, Rhs>::type Value;
+        return absoluteDifference<Value>(lhs, rhs, std::is_floating_point<Value>()) <= tolerance;
+    }
+
+    // Whether lhs and rhs are at most tolerance times the larger of their magnitudes apart
+    template<typename Lhs, typename Rhs, typename Tolerance>
+    inline bool withinRelative(const Lhs& lhs, const Rhs& rhs, const Tolerance& tolerance)
+    {
+        typedef typename std::common_type<Lhs, Rhs>::type Value;
+        const Value left = absoluteDifference<Value>(lhs, Value(), std::is_floating_point<Value>());
+        const Value right = absoluteDifference<Value>(rhs, Value(), std::is_floating_point<Value>());
+        return withinAbsolute(lhs, rhs, tolerance * ((left < right) ? right : left));
+    }
+
+    // How many representable values lie between two floats of the same width, the most there
+    // can be if either is NaN. -0 and +0 are 0 apart.
+    template<typename Float, typename Bits>
+    inline std::uint64_t representationsApart(Float lhs, Float rhs)
+    {
+        static_assert(sizeof(Float) == sizeof(Bits), "Bits must be as wide as Float");
+        if(lhs != lhs || rhs != rhs)
+            return std::numeric_limits<std::uint64_t>::max();
+        Bits left;
+        Bits right;
+        std::memcpy(&left, &lhs, sizeof(left));
+        std::memcpy(&right, &rhs, sizeof(right));
+        // Sign and magnitude to two's complement, so the integers are ordered like the floats
+        const Bits magnitude = std::numeric_limits<Bits>::max();
+        const std::int64_t first = (left < 0) ? -(std::int64_t)(left & magnitude) : (std::int64_t)left;
+        const std::int64_t second = (right < 0) ? -(std::int64_t)(right & magnitude) : (std::int64_t)right;
+        return (first < second) ? (std::uint64_t)second - (std::uint64_t)first : (std::uint64_t)first - (std::uint64_t)second;
+    }
+
+    inline std::uint64_t ulpsApart(float lhs, float rhs)
+    {
+        return representationsApart<float, std::int32_t>(lhs, rhs);
+    }
+
+    inline std::uint64_t ulpsApart(double lhs, double rhs)
+    {
+        return representationsApart<double, std::int64_t>(lhs, rhs);
+    }
+
+    // Whether lhs and rhs are at most ulps representable values apart
+    template<typename Lhs, typename Rhs>
+    inline bool withinUlps(const Lhs& lhs, const Rhs& rhs, std::uint64_t ulps)
+    {
+        typedef typename std::common_type<Lhs, Rhs>::type Value;
+        return ulpsApart((Value)lhs, (Value)rhs) <= ulps;
+    }
+
+    // Counter based splitmix64. Every value only depends on the seed and its position in the
+    // stream, so fill() has no loop-carried dependency and vectorizes.
+    class Random
+    {
+    public:
+        explicit Random(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next()
+        {
+            state += increment;
+            return mix(state);
+        }
+
+        // Same values as count calls to next()
+        void fill(std::uint64_t* values, size_t count)
+        {
+            const std::uint64_t base = state;
+            for(size_t i = 0; i < count; ++i)
+                values[i] = mix(base + (i + 1) * increment);
+            state = base + count * increment;
+        }
+
+        // Uniform in [0, bound)
+        std::uint64_t below(std::uint64_t bound)
+        {
+            return bound ? next() % bound : 0;
+        }
+
+        // Uniform in [0, 1)
+        double unit()
+        {
+            return (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        static std::uint64_t mix(std::uint64_t value)
+        {
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+            return value ^ (value >> 31);
+        }
+
+    private:
+        static const std::uint64_t increment = 0x9e3779b97f4a7c15ULL;
+        std::uint64_t state;
+    };
+
+    // Generates and shrinks the values property tests are checked against. Specialize it for
+    // your own types:
+    //     static void generate(Random& random, Value* values, size_t count);
+    //     static void shrink(const Value& value, std::vector<Value>& candidates);
+    // shrink() appends values simpler than value, the most promising first.
+    template<typename Value, typename Enable = void>
+    struct Arbitrary;
+
+    template<typename Value>
+    inline Value arbitrary(Random& random)
+    {
+        Value value;
+        Arbitrary<Value>::generate(random, &value, 1);
+        return value;
+    }
+
+    template<>
+    struct Arbitrary<bool>
+    {
+        static void generate(Random& random, bool* values, size_t count)
+        {
+            std::uint64_t bits[256];
+            for(size_t first = 0; first < count; first += 256)
+            {
+                const size_t batch = std::min<size_t>(256, count - first);
+                random.fill(bits, batch);
+                for(size_t i = 0; i < batch; ++i)
+                    values[first + i] = (bits[i] & 1) != 0;
+            }
+        }
+
+        static void shrink(const bool& value, std::vector<bool>& candidates)
+        {
+            if(value)
+                candidates.push_back(false);
+        }
+    };
+
+    template<typename Value>
+    struct Arbitrary<Value, typename std::enable_if<std::is_integral<Value>::value>::type>
+    {
+        static void generate(Random& random, Value* values, size_t count)
+        {
+            typedef typename std::make_unsigned<Value>::type Bits;
+            const unsigned width = sizeof(Value) * 8;
+            std::uint64_t bits[256];
+            for(size_t first = 0; first < count; first += 256)
+            {
+                const size_t batch = std::min<size_t>(256, count - first);
+                random.fill(bits, batch);
+                // A random bit width per value, so small values turn up as often as large ones
+                for(size_t i = 0; i < batch; ++i)
+                {
+                    Bits value = (Bits)((Bits)bits[i] >> ((unsigned)(bits[i] >> 58) % width));
+                    if(std::is_signed<Value>::value && ((bits[i] >> 57) & 1))
+                        value = (Bits)(0 - value);
+                    values[first + i] = (Value)value;
+                }
+            }
+        }
+
+        static void shrink(const Value& value, std::vector<Value>& candidates)
+        {
+            if(value == 0)
+                return;
+            const bool positive = value > 0;
+            candidates.push_back(0);
+            if(!positive && value != std::numeric_limits<Value>::min())
+                candidates.push_back((Value)(0 - value));
+            for(Value step = (Value)(value / 2); step != 0; step = (Value)(step / 2))
+                candidates.push_back((Value)(value - step));
+            candidates.push_back(positive ? (Value)(value - 1) : (Value)(value + 1));
+        }
+    };
+
+    template<typename Value>
+    struct Arbitrary<Value, typename std::enable_if<std::is_floating_point<Value>::value>::type>
+    {
+        static void generate(Random& random, Value* values, size_t count)
+        {
+            double scales[32];
+            for(int scale = 0; scale < 32; ++scale)
+                scales[scale] = std::ldexp(1.0, scale - 16);
+
+            std::uint64_t bits[256];
+            for(size_t first = 0; first < count; first += 256)
+            {
+                const size_t batch = std::min<size_t>(256, count - first);
+                random.fill(bits, batch);
+                // Uniform in [-1, 1) times a power of two in [2^-16, 2^15], and one value in 32 zero
+                for(size_t i = 0; i < batch; ++i)
+                {
+                    const double unit = (double)(bits[i] >> 11) * (1.0 / 9007199254740992.0);
+                    const double value = (unit * 2.0 - 1.0) * scales[bits[i] & 31];
+                    values[first + i] = (bits[i] & 0x3E0) ? (Value)value : (Value)0;
+                }
+            }
+        }
+
+        static void shrink(const Value& value, std::vector<Value>& candidates)
+        {
+            if(value == 0 || value != value)
+                return;
+            candidates.push_back(0);
+            if(value < 0)
+                candidates.push_back(-value);
+            const Value whole = std::trunc(value);
+            if(whole != value)
+            {
+                candidates.push_back(whole);
+                for(Value digits = 10; digits <= 1000000; digits *= 10)
+                {
+                    const Value rounded = std::round(value * digits) / digits;
+                    if(rounded != value)
+                        candidates.push_back(rounded);
+                }
+            }
+            else if(std::fabs(value) >= 2)
+            {
+                candidates.push_back(std::trunc(value / 2));
+                candidates.push_back(value < 0 ? value + 1 : value - 1);
+            }
+        }
+    };
+
+    template<>
+    struct Arbitrary<std::string>
+    {
+        // Up to 32 printable ASCII characters
+        static void generate(Random& random, std::string* values, size_t count)
+        {
+            for(size_t i = 0; i < count; ++i)
+            {
+                std::string& value = values[i];
+                value.resize((size_t)random.below(33));
+                for(size_t character = 0; character < value.size(); character += 8)
+                {
+                    std::uint64_t bits = random.next();
+                    for(size_t byte = character; byte < value.size() && byte < character + 8; ++byte, bits >>= 8)
+                        value[byte] = (char)(' ' + (bits & 0xFF) % 95);
+                }
+            }
+        }
+
+        static void shrink(const std::string& value, std::vector<std::string>& candidates)
+        {
+            if(value.empty())
+                return;
+            candidates.push_back(std::string());
+            if(value.size() > 1)
+            {
+                candidates.push_back(value.substr(0, value.size() / 2));
+                candidates.push_back(value.substr(value.size() / 2));
+            }
+            for(size_t character = 0; character < value.size(); ++character)
+                candidates.push_back(std::string(value).erase(character, 1));
+            for(size_t character = 0; character < value.size(); ++character)
+            {
+                if(value[character] != 'a')
+                {
+                    std::string simpler = value;
+                    simpler[character] = 'a';
+                    candidates.push_back(simpler);
+                }
+            }
+        }
+    };
+
+    // Byte level mutations of DEFINE_FUZZ_TEST inputs, stacked a few at a time. Splices take
+    // from the other inputs of the corpus.
+    class Mutator
+    {
+    public:
+        explicit Mutator(std::uint64_t seed) : random(seed) {}
+
+        void mutate(std::vector<std::uint8_t>& input, const std::vector<std::vector<std::uint8_t>>& corpus, size_t maxLength)
+        {
+            const size_t rounds = 1 + pick(4);
+            for(size_t round = 0; round < rounds; ++round)
+                mutateOnce(input, corpus, maxLength);
+            if(input.size() > maxLength)
+                input.resize(maxLength);
+        }
+
+        // Uniform in [0, count)
+        size_t pick(size_t count)
+        {
+            return (size_t)random.below(count);
+        }
+
+    private:
+        void mutateOnce(std::vector<std::uint8_t>& input, const std::vector<std::vector<std::uint8_t>>& corpus, size_t maxLength)
+        {
+            static const std::uint64_t interesting[] = { 0, 1, 0x7f, 0x80, 0xff, 0x100, 0x7fff, 0x8000, 0xffff,
+                0x10000, 0x7fffffff, 0x80000000, 0xffffffff, 0x7fffffffffffffffULL, 0xffffffffffffffffULL };
+            const size_t size = input.size();
+            switch(random.below(9))
+            {
+            case 0:
+                if(size > 0)
+                    input[pick(size)] ^= (std::uint8_t)(1u << random.below(8));
+                break;
+            case 1:
+                if(size > 0)
+                    input[pick(size)] = (std::uint8_t)random.next();
+                break;
+            case 2:
+                if(size > 0)
+                    input[pick(size)] += (std::uint8_t)(pick(33) - 16);
+                break;
+            case 3:
+            {
+                const size_t count = std::min<size_t>(1 + pick(8), (maxLength > size) ? maxLength - size : 0);
+                const size_t position = pick(size + 1);
+                input.insert(input.begin() + position, count, 0);
+                for(size_t i = 0; i < count; ++i)
+                    input[position + i] = (std::uint8_t)random.next();
+                break;
+            }
+            case 4:
+                if(size > 0)
+                {
+                    const size_t position = pick(size);
+                    const size_t count = 1 + pick(std::min<size_t>(size - position, 16));
+                    input.erase(input.begin() + position, input.begin() + position + count);
+                }
+                break;
+            case 5:
+            {
+                // 1, 2, 4 or 8 bytes of a boundary value, in either byte order
+                const size_t width = (size_t)1 << pick(4);
+                if(size < width)
+                    break;
+                const std::uint64_t value = interesting[pick(sizeof(interesting) / sizeof(interesting[0]))];
+                const size_t position = pick(size - width + 1);
+                const bool bigEndian = random.below(2) != 0;
+                for(size_t i = 0; i < width; ++i)
+                    input[position + i] = (std::uint8_t)(value >> (8 * (bigEndian ? width - 1 - i : i)));
+                break;
+            }
+            case 6:
+                if(size > 1)
+                {
+                    const size_t from = pick(size);
+                    const size_t to = pick(size);
+                    const size_t count = 1 + pick(std::min<size_t>(size - std::max(from, to), 32));
+                    std::memmove(&input[to], &input[from], count);
+                }
+                break;
+            case 7:
+                // Keep a prefix and go on with the tail of another input
+                if(!corpus.empty())
+                {
+                    const std::vector<std::uint8_t>& other = corpus[pick(corpus.size())];
+                    const size_t cut = pick(other.size() + 1);
+                    input.resize(pick(size + 1));
+                    input.insert(input.end(), other.begin() + cut, other.end());
+                }
+                break;
+            default:
+                // Insert a piece of another input
+                if(!corpus.empty())
+                {
+                    const std::vector<std::uint8_t>& other = corpus[pick(corpus.size())];
+                    if(other.empty())
+                        break;
+                    const size_t from = pick(other.size());
+                    const size_t count = 1 + pick(std::min<size_t>(other.size() - from, 32));
+                    input.insert(input.begin() + pick(size + 1), other.begin() + from, other.begin() + from + count);
+                }
+                break;
+            }
+        }
+
+        Random random;
+    };
+
+    // Bump allocator for objects that live until reset(). Blocks are kept across resets, so
+    // once warmed up it allocates nothing, and they come from malloc so that
+    // SLIMTEST_COUNT_ALLOCATIONS does not count them against the test.
+    class Arena
+    {
+    public:
+        Arena() : first(nullptr), current(nullptr), used(0), cleanups(nullptr) {}
+
+        ~Arena()
+        {
+            reset();
+            while(first)
+            {
+                Block* next = first->next;
+                std::free(first);
+                first = next;
+            }
+        }
+
+        template<typename Type, typename... Arguments>
+        Type* make(Arguments&&... arguments)
+        {
+            Cleanup* cleanup = nullptr;
+            if(!std::is_trivially_destructible<Type>::value)
+                cleanup = static_cast<Cleanup*>(allocate(sizeof(Cleanup), std::alignment_of<Cleanup>::value));
+            Type* object = new(allocate(sizeof(Type), std::alignment_of<Type>::value))
+                Type(std::forward<Arguments>(arguments)...);
+            if(cleanup)
+            {
+                cleanup->destroy = &destroy<Type>;
+                cleanup->object = object;
+                cleanup->next = cleanups;
+                cleanups = cleanup;
+            }
+            return object;
+        }
+
+        // Makes sure the next bytes worth of objects fit without allocating
+        void reserve(size_t bytes)
+        {
+            Block* block = current;
+            size_t available = block ? block->size - used : 0;
+            while(block && block->next && available < bytes)
+            {
+                block = block->next;
+                available += block->size;
+            }
+            if(available < bytes)
+                append(bytes - available, block);
+        }
+
+        // Destroys everything made since the last reset, newest first
+        void reset()
+        {
+            for(; cleanups; cleanups = cleanups->next)
+                cleanups->destroy(cleanups->object);
+            current = first;
+            used = 0;
+        }
+
+    private:
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+
+        struct Block
+        {
+            Block* next;
+            size_t size;
+        };
+
+        struct Cleanup
+        {
+            void (*destroy)(void*);
+            void* object;
+            Cleanup* next;
+        };
+
+        template<typename Type>
+        static void destroy(void* object)
+        {
+            static_cast<Type*>(object)->~Type();
+        }
+
+        void* allocate(size_t size, size_t alignment)
+        {
+            for(;;)
+            {
+                if(current)
+                {
+                    const size_t offset = (used + alignment - 1) & ~(alignment - 1);
+                    if(offset + size <= current->size)
+                    {
+                        used = offset + size;
+                        return reinterpret_cast<char*>(current + 1) + offset;
+                    }
+                }
+                if(current && current->next)
+                    current = current->next;
+                else
+                    current = append(size + alignment, current);
+                used = 0;
+            }
+        }
+
+        Block* append(size_t size, Block* last)
+        {
+            const size_t minimum = last ? last->size * 2 : 4096;
+            const size_t capacity = (size < minimum) ? minimum : size;
+            Block* block = static_cast<Block*>(std::malloc(sizeof(Block) + capacity));
+            if(!block)
+                throw std::bad_alloc();
+            block->next = nullptr;
+            block->size = capacity;
+            if(last)
+                last->next = block;
+            else
+                first = current = block;
+            return block;
+        }
+
+        Block* first;
+        Block* current;
+        size_t used;
+        Cleanup* cleanups;
+    };
+
+    // The result and argument types of a mocked function's signature
+    template<typename Signature>
+    struct MockSignature;
+
+    template<typename Result, typename... Arguments>
+    struct MockSignature<Result(Arguments...)>
+    {
+        typedef Result Returned;
+
+        template<size_t index>
+        struct Argument
+        {
+            typedef typename std::tuple_element<index, std::tuple<Arguments...>>::type Type;
+        };
+    };
+
+    // What a call answers with: the value an expectation returns(), or a default constructed one
+    template<typename Result>
+    struct MockResult
+    {
+        typedef typename std::decay<Result>::type Stored;
+
+        MockResult() : value(nullptr) {}
+
+        Result get() const
+        {
+            if(value)
+                return *value;
+            static Stored fallback = Stored();
+            return fallback;
+        }
+
+        Stored* value;
+    };
+
+    template<>
+    struct MockResult<void>
+    {
+        void get() const {}
+    };
+
+    // Records the calls made to a mocked function and checks them against the expectations
+    // set with expectCall, see MOCK_METHOD0. Calls, expectations and their values live in an
+    // arena that verify() recycles, so a mock called in a hot loop stops allocating once it is
+    // warmed up.
+    template<typename Signature>
+    class Mock;
+
+    template<typename Result, typename... Arguments>
+    class Mock<Result(Arguments...)>
+    {
+    public:
+        // The arguments of one call, copied
+        typedef std::tuple<typename std::decay<Arguments>::type...> Call;
+
+        // Exactly one matching call is expected unless told otherwise
+        class Expectation
+        {
+        public:
+            Expectation(Mock& mock, const TestRunner::Assertion& assertion)
+                : mock(&mock), assertion(&assertion), minimum(1), maximum(1), called(0), expected(nullptr),
+                matches(nullptr), next(nullptr) {}
+
+            Expectation& times(size_t count)
+            {
+                minimum = count;
+                maximum = count;
+                return *this;
+            }
+
+            Expectation& atLeast(size_t count)
+            {
+                minimum = count;
+                maximum = (size_t)-1;
+                return *this;
+            }
+
+            Expectation& atMost(size_t count)
+            {
+                minimum = 0;
+                maximum = count;
+                return *this;
+            }
+
+            // Only calls whose arguments equal values match
+            template<typename... Values>
+            Expectation& with(const Values&... values)
+            {
+                expected = mock->arena.template make<Call>(values...);
+                matches = &equal;
+                return *this;
+            }
+
+            template<typename Value>
+            Expectation& returns(const Value& value)
+            {
+                result.value = mock->arena.template make<typename MockResult<Result>::Stored>(value);
+                return *this;
+            }
+
+        private:
+            friend class Mock;
+
+            // Only instantiated by with(), so arguments need no operator== otherwise
+            static bool equal(const Call& lhs, const Call& rhs)
+            {
+                return lhs == rhs;
+            }
+
+            Mock* mock;
+            const TestRunner::Assertion* assertion;
+            size_t minimum;
+            size_t maximum;
+            size_t called;
+            const Call* expected;
+            bool (*matches)(const Call&, const Call&);
+            MockResult<Result> result;
+            Expectation* next;
+        };
+
+        // unexpected is reported against calls that match none of the expectations, as long
+        // as there are any; a mock without expectations is a plain stub
+        explicit Mock(const TestRunner::Assertion& unexpected)
+            : unexpected(&unexpected), expectations(nullptr), lastExpectation(&expectations), records(nullptr),
+            lastRecord(&records), recorded(0), unmatched(0) {}
+
+        ~Mock()
+        {
+            verify();
+        }
+
+        Expectation& expect(const TestRunner::Assertion& assertion)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Expectation* expectation = arena.template make<Expectation>(*this, assertion);
+            *lastExpectation = expectation;
+            lastExpectation = &expectation->next;
+            return *expectation;
+        }
+
+        // A call counts towards the first matching expectation that still wants calls, or
+        // else towards the first matching one
+        Result operator()(Arguments... arguments)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Record* record = arena.template make<Record>(arguments...);
+            *lastRecord = record;
+            lastRecord = &record->next;
+            ++recorded;
+
+            Expectation* chosen = nullptr;
+            for(Expectation* expectation = expectations; expectation; expectation = expectation->next)
+            {
+                if(expectation->matches && !expectation->matches(*expectation->expected, record->call))
+                    continue;
+                if(expectation->called < expectation->maximum)
+                {
+                    chosen = expectation;
+                    break;
+                }
+                if(!chosen)
+                    chosen = expectation;
+            }
+            if(!chosen)
+            {
+                ++unmatched;
+                return MockResult<Result>().get();
+            }
+            ++chosen->called;
+            return chosen->result.get();
+        }
+
+        // Reports every expectation that was not met and forgets all calls and expectations.
+        // Runs when the mock is destroyed; call it at the end of each test for a mock that
+        // outlives it, e.g. one held by a fixture.
+        void verify()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(Expectation* expectation = expectations; expectation; expectation = expectation->next)
+            {
+                if(SLIMTEST_UNLIKELY(expectation->called < expectation->minimum || expectation->called > expectation->maximum))
+                    TestRunner::recordFailure(*expectation->assertion, describe(*expectation));
+                TestRunner::incrementAssertionCount(*expectation->assertion);
+            }
+            if(expectations)
+            {
+                if(SLIMTEST_UNLIKELY(unmatched > 0))
+                {
+                    TestRunner::recordFailure(*unexpected, std::to_string(unmatched) + " of "
+                        + std::to_string(recorded) + " calls matched none");
+                }
+                TestRunner::incrementAssertionCount(*unexpected);
+            }
+
+            expectations = nullptr;
+            lastExpectation = &expectations;
+            records = nullptr;
+            lastRecord = &records;
+            recorded = 0;
+            unmatched = 0;
+            arena.reset();
+        }
+
+        size_t calls() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return recorded;
+        }
+
+        // The arguments of the index-th call since the last verify()
+        const Call& call(size_t index) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const Record* record = records;
+            for(; index > 0; --index)
+                record = record->next;
+            return record->call;
+        }
+
+        // Makes room for recording calls calls without allocating
+        void reserve(size_t calls)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            arena.reserve(calls * (sizeof(Record) + 3 * sizeof(void*) + std::alignment_of<Record>::value));
+        }
+
+    private:
+        Mock(const Mock&);
+        Mock& operator=(const Mock&);
+
+        struct Record
+        {
+            template<typename... Values>
+            explicit Record(Values&&... values) : call(std::forward<Values>(values)...), next(nullptr) {}
+
+            Call call;
+            Record* next;
+        };
+
+        static std::string describe(const Expectation& expectation)
+        {
+            std::ostringstream text;
+            text << "called " << expectation.called << " times, expected ";
+            if(expectation.minimum == expectation.maximum)
+                text << "exactly " << expectation.minimum;
+            else if(expectation.maximum == (size_t)-1)
+                text << "at least " << expectation.minimum;
+            else
+                text << "at most " << expectation.maximum;
+            return text.str();
+        }
+
+        const TestRunner::Assertion* unexpected;
+        Expectation* expectations;
+        Expectation** lastExpectation;
+        Record* records;
+        Record** lastRecord;
+        size_t recorded;
+        size_t unmatched;
+        Arena arena;
+        mutable std::mutex mutex;
+    };
+}
+
+template<typename Value>
+bool TestRunner::probe(void (*property)(const Value&), const Value& value)
+{
+    // A value the property throws for falsifies it as well
+    const Checkpoint before = checkpoint();
+    bool threw = false;
+    try
+    {
+        property(value);
+    }
+    catch(...)
+    {
+        threw = true;
+    }
+    if(!threw && !failedSince(before))
+        return false;
+    rollback(before);
+    return true;
+}
+
+template<typename Value>
+void TestRunner::checkProperty(const Assertion& assertion, void (*property)(const Value&))
+{
+    const TestRunner& runner = testRunner();
+    const size_t cases = runner.propertyCases;
+    const size_t batchSize = 256;
+    const size_t batches = (cases + batchSize - 1) / batchSize;
+    size_t threads = (runner.propertyThreads < batches) ? runner.propertyThreads : batches;
+    if(threads == 0)
+        threads = 1;
+
+    // Every property test gets its own stream of values, which only depends on the seed
+    std::uint64_t seed = runner.propertySeed;
+    for(const char* character = assertion.expression; *character; ++character)
+        seed = SlimTest::Random::mix(seed ^ (unsigned char)*character);
+
+    // Batches are handed out in order and each one is generated from its own stream, so the
+    // first failing value is the same whatever the number of threads
+    std::atomic<size_t> nextBatch(0);
+    std::atomic<size_t> firstFailure(cases);
+    std::mutex failureMutex;
+    std::vector<Value> counterexample;
+    auto check = [&]()
+    {
+        std::unique_ptr<Value[]> values(new Value[batchSize]);
+        for(;;)
+        {
+            const size_t batch = nextBatch.fetch_add(1);
+            const size_t first = batch * batchSize;
+            if(first >= firstFailure.load())
+                return;
+            const size_t count = (cases - first < batchSize) ? cases - first : batchSize;
+            SlimTest::Random random(SlimTest::Random::mix(seed + batch));
+            SlimTest::Arbitrary<Value>::generate(random, values.get(), count);
+            for(size_t i = 0; i < count; ++i)
+            {
+                if(probe<Value>(property, values[i]))
+                {
+                    std::lock_guard<std::mutex> lock(failureMutex);
+                    if(first + i < firstFailure.load())
+                    {
+                        firstFailure = first + i;
+                        counterexample.assign(1, values[i]);
+                    }
+                    return;
+                }
+            }
+        }
+    };
+
+    Context* test = currentTest();
+    std::vector<std::thread> helpers;
+    for(size_t thread = 1; thread < threads; ++thread)
+    {
+        helpers.push_back(std::thread([&]()
+        {
+            ThreadScope scope(test);
+            check();
+        }));
+    }
+    check();
+    for(auto&& helper : helpers)
+        helper.join();
+    if(counterexample.empty())
+        return;
+
+    Value smallest = counterexample.front();
+    size_t shrinks = 0;
+    std::vector<Value> candidates;
+    for(bool shrunk = true; shrunk && shrinks < 1000;)
+    {
+        shrunk = false;
+        candidates.clear();
+        SlimTest::Arbitrary<Value>::shrink(smallest, candidates);
+        for(auto&& candidate : candidates)
+        {
+            if(probe<Value>(property, candidate))
+            {
+                smallest = candidate;
+                ++shrinks;
+                shrunk = true;
+                break;
+            }
+        }
+    }
+
+    // Run the smallest failing value for real, so its failed assertions are reported too
+    std::ostringstream values;
+    values << "falsified by " << smallest << ", case " << firstFailure + 1 << " of " << cases
+        << ", shrunk " << shrinks << " times, --property-seed=" << runner.propertySeed;
+    try
+    {
+        property(smallest);
+    }
+    catch(...)
+    {
+        values << ", threw " << describeException();
+    }
+    recordFailure(assertion, values.str());
+}
+
+template<typename Value, typename Values>
+void TestRunner::checkParameters(const Assertion& assertion, const Values& values, void (*property)(const Value&))
+{
+    const size_t count = (size_t)std::distance(std::begin(values), std::end(values));
+    size_t parameter = 0;
+    for(auto&& value : values)
+    {
+        const Checkpoint before = checkpoint();
+        std::string thrown;
+        try
+        {
+            property(value);
+        }
+        catch(...)
+        {
+            thrown = ", threw " + describeException();
+        }
+        if(SLIMTEST_UNLIKELY(!thrown.empty() || failedSince(before)))
+        {
+            std::ostringstream failed;
+            failed << "falsified by " << value << ", parameter " << parameter + 1 << " of " << count << thrown;
+            recordFailure(assertion, failed.str());
+        }
+        ++parameter;
+    }
+}
+
+inline void TestRunner::checkStress(const Assertion& assertion, size_t threads, size_t iterations, void (*body)(size_t))
+{
+    if(threads == 0)
+        threads = 1;
+    std::uint64_t seed = testRunner().propertySeed;
+    for(const char* character = assertion.expression; *character; ++character)
+        seed = SlimTest::Random::mix(seed ^ (unsigned char)*character);
+
+    std::vector<StressThread> stressed(threads);
+    std::atomic<size_t> arrived(0);
+    std::atomic<bool> failed(false);
+    auto stress = [&](size_t thread)
+    {
+        StressThread& mine = stressed[thread];
+        mine.random = SlimTest::Random::mix(seed + thread) | 1;
+        mine.iterations = 0;
+        mine.failed = false;
+        ThreadState& state = threadState();
+        const Checkpoint before = checkpoint();
+
+        // Nobody starts before everybody is ready to, yielding once the spinning took too long
+        // in case there are more threads than cores
+        arrived.fetch_add(1, std::memory_order_acq_rel);
+        for(size_t spins = 0; arrived.load(std::memory_order_acquire) < threads; ++spins)
+        {
+            if(spins > 10000)
+                std::this_thread::yield();
+        }
+
+        state.stressing = &mine;
+        const auto started = std::chrono::steady_clock::now();
+        try
+        {
+            for(; mine.iterations < iterations && !failed.load(std::memory_order_relaxed); ++mine.iterations)
+            {
+                body(thread);
+                if(SLIMTEST_UNLIKELY(failedSince(before)))
+                    break;
+            }
+        }
+        catch(...)
+        {
+            mine.thrown = describeException();
+        }
+        mine.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        state.stressing = nullptr;
+        mine.failed = failedSince(before) || !mine.thrown.empty();
+        if(mine.failed)
+            failed = true;
+    };
+
+    Context* test = currentTest();
+    std::vector<std::thread> helpers;
+    for(size_t thread = 1; thread < threads; ++thread)
+    {
+        helpers.push_back(std::thread([&, thread]()
+        {
+            ThreadScope scope(test);
+            stress(thread);
+        }));
+    }
+    stress(0);
+    for(auto&& helper : helpers)
+        helper.join();
+
+    std::ostringstream rates;
+    rates << "Stressed " << assertion.expression << " on " << threads << " threads, iterations per second:";
+    for(size_t thread = 0; thread < threads; ++thread)
+    {
+        const StressThread& stress = stressed[thread];
+        rates << " " << std::fixed << std::setprecision(0) << ((stress.seconds > 0) ? stress.iterations / stress.seconds : 0.0);
+        if(!stress.failed)
+            continue;
+        std::ostringstream values;
+        values << "failed on thread " << thread << " in iteration " << stress.iterations + 1 << " of " << iterations;
+        if(!stress.thrown.empty())
+            values << ", threw " << stress.thrown;
+        recordFailure(assertion, values.str());
+    }
+    rates << "\n";
+    output(rates.str());
+}
+
+// Gives the other threads a chance to run in between this thread's steps: mostly a yield,
+// now and then a short spin or a sleep long enough to be preempted
+inline void TestRunner::perturb(StressThread& thread)
+{
+    std::uint64_t& random = thread.random;
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    const unsigned roll = (unsigned)(random & 63);
+    if(roll == 0)
+        std::this_thread::sleep_for(std::chrono::microseconds((random >> 8) & 63));
+    else if(roll < 5)
+    {
+        for(std::uint64_t spin = (random >> 8) & 1023; spin > 0; --spin)
+            SlimTest::doNotOptimize(spin);
+    }
+    else if(roll < 24)
+        std::this_thread::yield();
+}
+
+inline void TestRunner::checkFuzzTarget(const Assertion& assertion, const char* name,
+    void (*target)(const std::uint8_t*, size_t))
+{
+    if(testRunner().fuzzing)
+        fuzz(assertion, name, target);
+    else
+        replayCorpus(assertion, name, target);
+}
+
+inline void TestRunner::replayCorpus(const Assertion& assertion, const char* name,
+    void (*target)(const std::uint8_t*, size_t))
+{
+    // The empty input first, then whatever fuzzing kept or found failing
+    const std::string directory = testRunner().corpus + "/" + name;
+    std::vector<std::string> names;
+    listDirectory(directory, names);
+    std::sort(names.begin(), names.end());
+    names.insert(names.begin(), std::string());
+
+    std::vector<std::uint8_t> input;
+    catchFuzzCrashes(true);
+    for(auto&& file : names)
+    {
+        const std::string path = directory + "/" + file;
+        if(!file.empty() && !readInput(path, input))
+            continue;
+        fuzzCrash().replaying = path.c_str();
+        std::string thrown;
+        if(SLIMTEST_UNLIKELY(runFuzzInput(target, input, thrown)))
+            recordFailure(assertion, "failed on " + (file.empty() ? std::string("the empty input") : "input " + path) + thrown);
+    }
+    fuzzCrash().replaying = nullptr;
+    catchFuzzCrashes(false);
+}
+
+inline void TestRunner::fuzz(const Assertion& assertion, const char* name, void (*target)(const std::uint8_t*, size_t))
+{
+    TestRunner& runner = testRunner();
+    FuzzSession& session = *runner.fuzzing;
+    ++session.fuzzed;
+    makeDirectory(runner.corpus);
+    const std::string directory = runner.corpus + "/" + name;
+    makeDirectory(directory);
+
+#ifndef SLIMTEST_WINDOWS
+    // Every worker is a process of its own with its own coverage, they share what they find
+    // through the directory
+    struct Child
+    {
+        pid_t pid;
+        int report;
+    };
+    std::vector<Child> children;
+    for(size_t worker = 1; worker < session.workers; ++worker)
+    {
+        int report[2];
+        if(pipe(report) != 0)
+            break;
+        if(runner.sink)
+            runner.sink->flush();
+        std::cout.flush();
+        const pid_t pid = fork();
+        if(pid == 0)
+        {
+            if(runner.sink)
+                runner.sink->abandon();
+            runner.sink = nullptr;
+            close(report[0]);
+            const bool failed = fuzzWorker(assertion, target, directory, worker, report[1]);
+            if(failed)
+            {
+                std::ostringstream text;
+                formatFailures(text, threadState().failures);
+                text << "Fuzz worker " << worker << " of " << name << " FAILED\n\n";
+                std::cout << text.str() << std::flush;
+            }
+            _exit(failed ? 1 : 0);
+        }
+        close(report[1]);
+        if(pid < 0)
+        {
+            close(report[0]);
+            break;
+        }
+        Child child = { pid, report[0] };
+        children.push_back(child);
+    }
+#endif
+
+    const bool failed = fuzzWorker(assertion, target, directory, 0, -1);
+
+#ifndef SLIMTEST_WINDOWS
+    for(size_t worker = 0; worker < children.size(); ++worker)
+    {
+        const Child& child = children[worker];
+        if(failed)
+            kill(child.pid, SIGKILL);
+        std::string saved;
+        readUntilClosed(child.report, saved);
+        close(child.report);
+        int status = 0;
+        while(waitpid(child.pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        if(failed || (WIFEXITED(status) && WEXITSTATUS(status) == 0))
+            continue;
+
+        std::ostringstream text;
+        text << "fuzz worker " << worker + 1;
+        if(WIFSIGNALED(status))
+            text << " crashed with signal " << WTERMSIG(status);
+        else
+            text << " failed";
+        text << " on input " << (saved.empty() ? std::string("that could not be saved") : saved.substr(0, saved.find('\n')));
+        recordFailure(assertion, text.str());
+    }
+#endif
+}
+
+inline bool TestRunner::fuzzWorker(const Assertion& assertion, void (*target)(const std::uint8_t*, size_t),
+    const std::string& directory, size_t worker, int report)
+{
+    const FuzzSession& session = *testRunner().fuzzing;
+    const std::int64_t started = steadyMilliseconds();
+    const std::int64_t deadline = started + (std::int64_t)(session.duration * 1000);
+    SlimTest::Mutator mutator(SlimTest::Random::mix(session.seed + worker));
+    std::vector<std::vector<std::uint8_t>> inputs;
+    std::set<std::string> known;
+    size_t executions = 0;
+    bool failed = false;
+
+    FuzzCrash& crash = fuzzCrash();
+    std::strncpy(crash.directory, directory.c_str(), sizeof(crash.directory) - 1);
+    crash.report = report;
+    catchFuzzCrashes(true);
+
+    // Failing inputs are kept as crash- files, which replay with the regular tests
+    auto run = [&](const std::vector<std::uint8_t>& input)
+    {
+        ++executions;
+        crash.data = input.data();
+        crash.size = input.size();
+        std::string thrown;
+        if(SLIMTEST_UNLIKELY(runFuzzInput(target, input, thrown)))
+        {
+            const std::string path = directory + "/crash-" + inputName(input);
+            const bool saved = saveInput(path, input);
+            recordFailure(assertion, "failed on input " + (saved ? path : std::string("that could not be saved")) + thrown);
+            if(report >= 0 && saved)
+                writeAll(report, (path + "\n").data(), path.size() + 1);
+            failed = true;
+        }
+        return !failed;
+    };
+
+    // Picks up what the other workers kept, and stops once one of them failed
+    auto refresh = [&](bool initial)
+    {
+        std::vector<std::string> names;
+        listDirectory(directory, names);
+        for(auto&& name : names)
+        {
+            if(!known.insert(name).second)
+                continue;
+            if(name.compare(0, 6, "crash-") == 0)
+            {
+                if(!initial)
+                    return false;
+                continue;
+            }
+            std::vector<std::uint8_t> input;
+            if(!readInput(directory + "/" + name, input))
+                continue;
+            if(!run(input))
+                return false;
+            inputs.push_back(input);
+        }
+        return true;
+    };
+
+    bool going = refresh(true);
+    if(going && inputs.empty())
+    {
+        inputs.push_back(std::vector<std::uint8_t>());
+        going = run(inputs.back());
+    }
+
+    std::vector<std::uint8_t> candidate;
+    std::int64_t nextRefresh = steadyMilliseconds() + 1000;
+    while(going && !testRunner().stopped())
+    {
+        if((executions & 255) == 0)
+        {
+            const std::int64_t now = steadyMilliseconds();
+            if(now >= deadline)
+                break;
+            if(now >= nextRefresh)
+            {
+                going = refresh(false);
+                nextRefresh = now + 1000;
+                continue;
+            }
+        }
 
-    std::vector<std::function<void ()>> testFunctions;
-    size_t failedAssertions;
-    size_t totalAssertions;
+        candidate = inputs[mutator.pick(inputs.size())];
+        mutator.mutate(candidate, inputs, session.maxLength);
+        const std::uint64_t before = coverageGrowth();
+        going = run(candidate);
+        if(going && coverageGrowth() != before)
+        {
+            const std::string name = inputName(candidate);
+            if(known.insert(name).second)
+            {
+                saveInput(directory + "/" + name, candidate);
+                inputs.push_back(candidate);
+            }
+        }
+    }
 
-    void resetAssertionCounts();
-};
+    catchFuzzCrashes(false);
+    crash.directory[0] = '\0';
+    if(worker == 0)
+    {
+        std::ostringstream text;
+        text << "Fuzzed " << directory << " for " << (steadyMilliseconds() - started) / 1000.0 << " s, "
+            << executions << " executions in the first of " << session.workers << " workers, "
+            << inputs.size() << " inputs kept, seed " << session.seed << "\n";
+        output(text.str());
+    }
+    return failed;
+}
 
-inline TestRunner::TestRunner(std::initializer_list<std::function<void ()>> functions)
-    : failedAssertions(0), totalAssertions(0)
+inline bool TestRunner::runFuzzInput(void (*target)(const std::uint8_t*, size_t), const std::vector<std::uint8_t>& input,
+    std::string& thrown)
 {
-    registerTests(functions);
+    const Checkpoint before = checkpoint();
+    try
+    {
+        target(input.data(), input.size());
+    }
+    catch(...)
+    {
+        thrown = ", threw " + describeException();
+    }
+    return !thrown.empty() || failedSince(before);
 }
 
-inline int TestRunner::runTests(const std::string& name)
+inline TestRunner::FuzzCrash& TestRunner::fuzzCrash()
 {
-    return testRunner().internalRunTests(name);
+    // Per thread, a crash is handled on the thread that crashed
+    static SLIMTEST_THREAD_LOCAL FuzzCrash crash;
+    return crash;
 }
 
-inline int TestRunner::internalRunTests(const std::string& name)
+// Crashing inputs are saved before the process goes down, or named when they are replayed.
+// Fuzz tests replaying on several threads share the handlers. The previous actions are put
+// back whole, flags and all, so a sanitizer's SA_SIGINFO handler survives.
+inline void TestRunner::catchFuzzCrashes(bool catching)
 {
-    resetAssertionCounts();
+#ifndef SLIMTEST_WINDOWS
+    static const int fatal[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS };
+    static struct sigaction previousActions[sizeof(fatal) / sizeof(fatal[0])];
+    static std::mutex mutex;
+    static size_t catchers = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(catching ? catchers++ > 0 : --catchers > 0)
+        return;
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = fuzzCrashed;
+    sigemptyset(&action.sa_mask);
+    for(size_t i = 0; i < sizeof(fatal) / sizeof(fatal[0]); ++i)
+    {
+        if(catching)
+            sigaction(fatal[i], &action, &previousActions[i]);
+        else
+            sigaction(fatal[i], &previousActions[i], nullptr);
+    }
+#else
+    (void)catching;
+#endif
+}
 
-    size_t failed = 0;
-    size_t counter = 0;
-    const size_t total = testFunctions.size();
-    for(auto&& function : testFunctions)
+#ifndef SLIMTEST_WINDOWS
+inline void TestRunner::fuzzCrashed(int number)
+{
+    // Only async signal safe calls from here on
+    const FuzzCrash& crash = fuzzCrash();
+    if(crash.replaying)
     {
-        function();
-        ++counter;
-        if(failedAssertions > 0)
+        const char crashedOn[] = "Crashed on fuzz input ";
+        writeAll(STDERR_FILENO, crashedOn, sizeof(crashedOn) - 1);
+        writeAll(STDERR_FILENO, crash.replaying, std::strlen(crash.replaying));
+        writeAll(STDERR_FILENO, "\n", 1);
+    }
+    else if(crash.directory[0])
+    {
+        char path[sizeof(crash.directory) + 32];
+        size_t length = std::strlen(crash.directory);
+        std::memcpy(path, crash.directory, length);
+        std::memcpy(path + length, "/crash-", 7);
+        length += 7;
+        const std::uint64_t hash = inputHash(crash.data, crash.size);
+        for(int shift = 60; shift >= 0; shift -= 4)
+            path[length++] = "0123456789abcdef"[(hash >> shift) & 15];
+        path[length] = '\0';
+
+        const int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(file >= 0)
         {
-            std::cout << "Test Function FAILED in test " 
-                << counter << std::endl << std::endl;
-            ++failed;
+            writeAll(file, crash.data, crash.size);
+            close(file);
+            path[length++] = '\n';
+            if(crash.report >= 0)
+                writeAll(crash.report, path, length);
+            else
+            {
+                const char saved[] = "Fuzz input saved as ";
+                writeAll(STDERR_FILENO, saved, sizeof(saved) - 1);
+                writeAll(STDERR_FILENO, path, length);
+            }
         }
-        resetAssertionCounts();
     }
+    crashed(number);
+}
+#endif
+
+// FNV-1a, also used from the crash handler
+inline std::uint64_t TestRunner::inputHash(const std::uint8_t* data, size_t size)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    return hash;
+}
 
-    std::cout << total - failed << " tests passed out of " << total << " tests in " 
-        << name << "." << std::endl;
+inline std::string TestRunner::inputName(const std::vector<std::uint8_t>& input)
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << inputHash(input.data(), input.size());
+    return name.str();
+}
 
-    return (int)failed;
+// Names of the files in path, leaving out hidden ones
+inline bool TestRunner::listDirectory(const std::string& path, std::vector<std::string>& names)
+{
+#ifdef SLIMTEST_WINDOWS
+    _finddata_t found;
+    const intptr_t handle = _findfirst((path + "/*").c_str(), &found);
+    if(handle == -1)
+        return false;
+    do
+    {
+        if(!(found.attrib & _A_SUBDIR) && found.name[0] != '.')
+            names.push_back(found.name);
+    } while(_findnext(handle, &found) == 0);
+    _findclose(handle);
+#else
+    DIR* directory = opendir(path.c_str());
+    if(!directory)
+        return false;
+    while(const dirent* entry = readdir(directory))
+        if(entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    closedir(directory);
+#endif
+    return true;
 }
 
-inline void TestRunner::registerTests(std::initializer_list<std::function<void ()>> functions)
+inline void TestRunner::makeDirectory(const std::string& path)
 {
-    testRunner().internalRegisterTests(functions);
+#ifdef SLIMTEST_WINDOWS
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0777);
+#endif
 }
 
-inline void TestRunner::internalRegisterTests(std::initializer_list<std::function<void ()>> functions)
+inline bool TestRunner::readInput(const std::string& path, std::vector<std::uint8_t>& input)
 {
-    for(auto&& function : functions)
-        testFunctions.push_back(function);
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if(!file)
+        return false;
+    input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
 }
 
-inline void TestRunner::incrementAssertionCount()
+// Written next to path and renamed, so other workers never read half an input
+inline bool TestRunner::saveInput(const std::string& path, const std::vector<std::uint8_t>& input)
 {
-    testRunner().internalIncrementAssertionCount();
+    const size_t slash = path.rfind('/');
+    std::ostringstream partial;
+    partial << path.substr(0, slash + 1) << "." << path.substr(slash + 1) << "." << std::this_thread::get_id();
+#ifndef SLIMTEST_WINDOWS
+    partial << "." << getpid();
+#endif
+    {
+        std::ofstream file(partial.str().c_str(), std::ios::binary);
+        if(!file.write(reinterpret_cast<const char*>(input.data()), (std::streamsize)input.size()) || !file.flush())
+            return false;
+    }
+    if(std::rename(partial.str().c_str(), path.c_str()) == 0)
+        return true;
+    // Windows does not replace; whatever is there has the same name, so the same bytes
+    std::remove(partial.str().c_str());
+    std::ifstream existing(path.c_str());
+    return (bool)existing;
 }
 
-inline void TestRunner::internalIncrementAssertionCount()
+inline std::uint64_t TestRunner::coverageGrowth()
 {
-    ++totalAssertions;
+#ifdef SLIMTEST_HAS_COVERAGE
+    return __atomic_load_n(&coverageMap().growth, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif
 }
 
-inline void TestRunner::incrementFailedAssertions()
+template<typename Lhs, typename Rhs, typename Tolerance>
+void TestRunner::checkArrayNear(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count, Tolerance tolerance)
 {
-    testRunner().internalIncrementFailedAssertions();
+    checkSpan(assertion, lhs, rhs, count, [tolerance](const Lhs& left, const Rhs& right)
+    {
+        return SlimTest::withinAbsolute(left, right, tolerance);
+    });
 }
 
-inline void TestRunner::internalIncrementFailedAssertions()
+template<typename Lhs, typename Rhs>
+void TestRunner::checkSpanEqual(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count)
 {
-    ++failedAssertions;
+    // Equal integers are equal bytes, and memcmp is as fast as comparing gets
+    if(std::is_integral<Lhs>::value && std::is_same<Lhs, Rhs>::value && count > 0
+        && std::memcmp(lhs, rhs, count * sizeof(Lhs)) == 0)
+        return;
+    checkSpan(assertion, lhs, rhs, count, [](const Lhs& left, const Rhs& right) { return left == right; });
 }
 
-inline void TestRunner::resetAssertionCounts()
+// Full blocks have a constant trip count and no early exit, so the mismatch count vectorizes
+// even where the compiler only vectorizes loops that need no epilogue. Only a block with
+// mismatches is scanned again for their indices.
+template<typename Lhs, typename Rhs, typename Matches>
+void TestRunner::checkSpan(const Assertion& assertion, const Lhs* lhs, const Rhs* rhs, size_t count, Matches matches)
 {
-    totalAssertions = 0;
-    failedAssertions = 0;
+    const size_t block = 1024;
+    const size_t shown = 5;
+    size_t mismatches = 0;
+    size_t reported = 0;
+    std::ostringstream first;
+    first << std::setprecision(std::numeric_limits<typename std::common_type<Lhs, Rhs>::type>::max_digits10);
+    for(size_t start = 0; start < count; start += block)
+    {
+        const Lhs* left = lhs + start;
+        const Rhs* right = rhs + start;
+        const size_t size = (count - start < block) ? count - start : block;
+        size_t differing = 0;
+        if(size == block)
+        {
+            for(size_t i = 0; i < block; ++i)
+                differing += !matches(left[i], right[i]);
+        }
+        else
+        {
+            for(size_t i = 0; i < size; ++i)
+                differing += !matches(left[i], right[i]);
+        }
+        if(SLIMTEST_UNLIKELY(differing > 0))
+        {
+            for(size_t i = 0; i < size && reported < shown; ++i)
+            {
+                if(!matches(left[i], right[i]))
+                {
+                    first << ((reported == 0) ? ", first at [" : ", [") << start + i << "] " << left[i] << " vs " << right[i];
+                    ++reported;
+                }
+            }
+            mismatches += differing;
+        }
+    }
+    if(mismatches > 0)
+        recordFailure(assertion, std::to_string(mismatches) + " of " + std::to_string(count) + " elements differ" + first.str());
 }
 
-inline TestRunner& TestRunner::testRunner()
+template<typename Lhs, typename Rhs>
+void TestRunner::failNear(const Assertion& assertion, const Lhs& lhs, const Rhs& rhs)
 {
-    static TestRunner singleton({});
-    return singleton;
+    std::ostringstream values;
+    values << std::setprecision(std::numeric_limits<typename std::common_type<Lhs, Rhs>::type>::max_digits10)
+        << lhs << ", " << rhs;
+    recordFailure(assertion, values.str());
+}
+
+template<typename Exception, typename Call>
+void TestRunner::checkThrows(const Assertion& assertion, Call call)
+{
+    try
+    {
+        call();
+    }
+    catch(const Exception&)
+    {
+        return;
+    }
+    catch(...)
+    {
+        recordFailure(assertion, "threw " + describeException());
+        return;
+    }
+    recordFailure(assertion, "");
+}
+
+template<typename Call>
+void TestRunner::checkNoThrow(const Assertion& assertion, Call call)
+{
+    try
+    {
+        call();
+    }
+    catch(...)
+    {
+        recordFailure(assertion, describeException());
+    }
+}
+
+template<typename Statement>
+void TestRunner::checkDeath(const Assertion& assertion, Statement statement, const char* pattern, const int* code)
+{
+#ifndef SLIMTEST_WINDOWS
+    int errors = -1;
+    int returned = -1;
+    const pid_t child = forkDeathTest(errors, returned);
+    if(child == 0)
+    {
+        // Surviving the statement is the failure, the parent is told how it was survived
+        std::string survived("returned");
+        try
+        {
+            statement();
+        }
+        catch(...)
+        {
+            survived = "threw " + describeException();
+        }
+        writeAll(returned, survived.data(), survived.size());
+        _exit(0);
+    }
+    if(child < 0)
+    {
+        recordFailure(assertion, "could not fork the child to run it in");
+        return;
+    }
+    awaitDeath(assertion, child, errors, returned, pattern, code);
+#else
+    (void)statement;
+    (void)pattern;
+    (void)code;
+    recordFailure(assertion, "death tests need fork, which Windows lacks");
+#endif
+}
+
+template<typename Call>
+bool TestRunner::guard(const TestCase& test, Call call)
+{
+    try
+    {
+        call();
+        return true;
+    }
+    catch(...)
+    {
+        std::string values = describeException();
+        const Assertion* last = threadState().lastAssertion.load(std::memory_order_relaxed);
+        if(last)
+        {
+            std::ostringstream reached;
+            reached << ", last assertion reached: " << last->expression << " at " << last->file << " " << last->line;
+            values += reached.str();
+        }
+        recordFailure(test.thrown, values);
+        return false;
+    }
 }
 
 #ifdef assertTrue
     #undef assertTrue
 #endif
 #define assertTrue(expression) \
-    if(!(expression)) \
+    do \
     { \
-        std::cout << "Assertion failed: " << #expression << "." << std::endl \
-            << "    Expected true but was false (" << (expression) << ")" \
-            << std::endl << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #expression, "true but was false" }; \
+        const auto& slimTestValue = (expression); \
+        if(SLIMTEST_UNLIKELY(!(slimTestValue))) \
+            TestRunner::fail(slimTestAssertion, slimTestValue); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
 
 #ifdef assertFalse
     #undef assertFalse
 #endif
 #define assertFalse(expression) \
-    if(expression) \
+    do \
     { \
-        std::cout << "Assertion failed: " << #expression << "." << std::endl \
-            << "    Expected false but was true (" << (expression) << ")" \
-            << std::endl << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #expression, "false but was true" }; \
+        const auto& slimTestValue = (expression); \
+        if(SLIMTEST_UNLIKELY(!!(slimTestValue))) \
+            TestRunner::fail(slimTestAssertion, slimTestValue); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef __ASSERT_BINARY
+    #undef __ASSERT_BINARY
+#endif
+#define __ASSERT_BINARY(lhs, rhs, operation, expectation) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #lhs " " #operation " " #rhs, expectation }; \
+        const auto& slimTestLhs = (lhs); \
+        const auto& slimTestRhs = (rhs); \
+        if(SLIMTEST_UNLIKELY(!(slimTestLhs operation slimTestRhs))) \
+            TestRunner::fail(slimTestAssertion, slimTestLhs, slimTestRhs); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
 
 #ifdef assertEqual
     #undef assertEqual
 #endif
 #define assertEqual(lhs, rhs) \
-    if(!((lhs) == (rhs))) \
-    { \
-        std::cout << "Assertion failed: " << #lhs << " == " << #rhs << "." << std::endl \
-            << "    Expected equal but were unequal (" << (lhs) << ", " << (rhs) << ")" \
-            << std::endl << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+    __ASSERT_BINARY(lhs, rhs, ==, "equal but were unequal")
 
 #ifdef assertNotEqual
     #undef assertNotEqual
 #endif
 #define assertNotEqual(lhs, rhs) \
-    if(!((lhs) != (rhs))) \
-    { \
-        std::cout << "Assertion failed: " << #lhs << " != " << #rhs \
-            << ". Expected not equal but were equal (" << (lhs) << ", " << (rhs) << ")" << std::endl; \
-        std::cout << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+    __ASSERT_BINARY(lhs, rhs, !=, "not equal but were equal")
 
 #ifdef assertNotNull
     #undef assertNotNull
@@ -203,53 +5949,144 @@ inline TestRunner& TestRunner::testRunner()
     #undef assertGreaterThan
 #endif
 #define assertGreaterThan(lhs, rhs) \
-    if(!((lhs) > (rhs))) \
-    { \
-        std::cout << "Assertion failed: " << #lhs << " > " #rhs \
-            << ". Expected greater than but was not (" << (lhs) << ", " << (rhs) << ")" << std::endl; \
-        std::cout << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+    __ASSERT_BINARY(lhs, rhs, >, "greater than but was not")
 
 #ifdef assertLessThan
     #undef assertLessThan
 #endif
 #define assertLessThan(lhs, rhs) \
-    if(!((lhs) < (rhs))) \
-    { \
-        std::cout << "Assertion failed: " << #lhs << " < " #rhs \
-            << ". Expected less than but was not (" << (lhs) << ", " << (rhs) << ")" << std::endl; \
-        std::cout << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+    __ASSERT_BINARY(lhs, rhs, <, "less than but was not")
 
 #ifdef assertGreaterThanOrEqual
     #undef assertGreaterThanOrEqual
 #endif
 #define assertGreaterThanOrEqual(lhs, rhs) \
-    if(!((lhs) >= (rhs))) \
-    { \
-        std::cout << "Assertion failed: " << #lhs << " >= " #rhs \
-            << ". Expected greater or equal than but was not (" << (lhs) << ", " << (rhs) << ")" << std::endl; \
-        std::cout << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+    __ASSERT_BINARY(lhs, rhs, >=, "greater or equal than but was not")
 
 #ifdef assertLessThanOrEqual
     #undef assertLessThanOrEqual
 #endif
 #define assertLessThanOrEqual(lhs, rhs) \
-    if(!((lhs) <= (rhs))) \
+    __ASSERT_BINARY(lhs, rhs, <=, "less than or equal but was not")
+
+#ifdef assertNear
+    #undef assertNear
+#endif
+#define assertNear(lhs, rhs, tolerance) \
+    __ASSERT_NEAR(lhs, rhs, withinAbsolute, tolerance, #lhs " == " #rhs " +- " #tolerance)
+
+#ifdef assertNearRelative
+    #undef assertNearRelative
+#endif
+#define assertNearRelative(lhs, rhs, tolerance) \
+    __ASSERT_NEAR(lhs, rhs, withinRelative, tolerance, #lhs " == " #rhs " +- " #tolerance " relative")
+
+#ifdef assertNearUlps
+    #undef assertNearUlps
+#endif
+#define assertNearUlps(lhs, rhs, ulps) \
+    __ASSERT_NEAR(lhs, rhs, withinUlps, ulps, #lhs " == " #rhs " +- " #ulps " ulps")
+
+#ifdef __ASSERT_NEAR
+    #undef __ASSERT_NEAR
+#endif
+#define __ASSERT_NEAR(lhs, rhs, within, tolerance, expression) \
+    do \
     { \
-        std::cout << "Assertion failed: " << #lhs << " <= " #rhs \
-            << ". Expected less than or equal but was not (" << (lhs) << ", " << (rhs) << ")" << std::endl; \
-        std::cout << "    At: " << __FILE_NAME << " " << __LINE_NUMBER << std::endl; \
-        TestRunner::incrementFailedAssertions(); \
-    } \
-    TestRunner::incrementAssertionCount();
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, expression, "near but were not" }; \
+        const auto& slimTestLhs = (lhs); \
+        const auto& slimTestRhs = (rhs); \
+        if(SLIMTEST_UNLIKELY(!SlimTest::within(slimTestLhs, slimTestRhs, (tolerance)))) \
+            TestRunner::failNear(slimTestAssertion, slimTestLhs, slimTestRhs); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertArrayNear
+    #undef assertArrayNear
+#endif
+#define assertArrayNear(lhs, rhs, count, tolerance) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #lhs " == " #rhs " +- " #tolerance " for " #count " elements", \
+            "every element near but some were not" }; \
+        TestRunner::checkArrayNear(slimTestAssertion, (lhs), (rhs), (count), (tolerance)); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertSpanEqual
+    #undef assertSpanEqual
+#endif
+#define assertSpanEqual(lhs, rhs, count) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #lhs " == " #rhs " for " #count " elements", \
+            "every element equal but some were unequal" }; \
+        TestRunner::checkSpanEqual(slimTestAssertion, (lhs), (rhs), (count)); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertThrows
+    #undef assertThrows
+#endif
+#define assertThrows(exception, expression) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #expression, #exception " thrown but was not" }; \
+        TestRunner::checkThrows<exception>(slimTestAssertion, [&]() { (void)(expression); }); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertNoThrow
+    #undef assertNoThrow
+#endif
+#define assertNoThrow(expression) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #expression, "no exception but threw" }; \
+        TestRunner::checkNoThrow(slimTestAssertion, [&]() { (void)(expression); }); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertDeath
+    #undef assertDeath
+#endif
+#define assertDeath(statement, pattern) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #statement, "death with stderr matching " #pattern }; \
+        TestRunner::checkDeath(slimTestAssertion, [&]() { statement; }, (pattern), nullptr); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef assertExit
+    #undef assertExit
+#endif
+#define assertExit(statement, code) \
+    do \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #statement, "exit with status " #code }; \
+        const int slimTestCode = (code); \
+        TestRunner::checkDeath(slimTestAssertion, [&]() { statement; }, "", &slimTestCode); \
+        TestRunner::incrementAssertionCount(slimTestAssertion); \
+    } while(false)
+
+#ifdef expectCall
+    #undef expectCall
+#endif
+#define expectCall(object, name) \
+    (object).name ## Mock.expect([]() -> const TestRunner::Assertion& \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #object "." #name, "the right number of calls" }; \
+        return slimTestAssertion; \
+    }())
 
 #ifdef __LINE_NUMBER
     #undef __LINE_NUMBER
@@ -267,18 +6104,266 @@ inline TestRunner& TestRunner::testRunner()
     #undef DEFINE_TEST_FUNCTION
 #endif
 #define DEFINE_TEST_FUNCTION(...) \
-    REGISTER_TEST_FUNCTIONS( \
+    __REGISTER_NAMED_TEST_FUNCTIONS("", \
+        []() \
+        { \
+            __VA_ARGS__ \
+        } \
+    )
+
+#ifdef DEFINE_NAMED_TEST_FUNCTION
+    #undef DEFINE_NAMED_TEST_FUNCTION
+#endif
+#define DEFINE_NAMED_TEST_FUNCTION(name, ...) \
+    __REGISTER_NAMED_TEST_FUNCTIONS(#name, \
         []() \
         { \
             __VA_ARGS__ \
         } \
     )
 
+#ifdef DEFINE_BENCHMARK_FUNCTION
+    #undef DEFINE_BENCHMARK_FUNCTION
+#endif
+#define DEFINE_BENCHMARK_FUNCTION(name, ...) \
+    static TestRunner::Registration ___EXPANDED_LINE_NUMBER(__LINE__) \
+        (#name, [](size_t slimTestIterations) \
+        { \
+            __VA_ARGS__ \
+        });
+
+#ifdef DEFINE_FIXTURE_TEST
+    #undef DEFINE_FIXTURE_TEST
+#endif
+#define DEFINE_FIXTURE_TEST(name, Type, instance, ...) \
+    __REGISTER_FIXTURE_TEST_FUNCTIONS(#name, &TestRunner::fixtureSlot<Type>(), \
+        []() \
+        { \
+            Type& instance = TestRunner::fixture<Type>(); \
+            (void)instance; \
+            __VA_ARGS__ \
+        } \
+    )
+
+#ifdef SET_TEST_TIMEOUT
+    #undef SET_TEST_TIMEOUT
+#endif
+#define SET_TEST_TIMEOUT(name, milliseconds) \
+    static TestRunner::Registration ___EXPANDED_LINE_NUMBER(__LINE__)(#name, (unsigned)(milliseconds));
+
+#ifdef DEFINE_PROPERTY_TEST
+    #undef DEFINE_PROPERTY_TEST
+#endif
+#define DEFINE_PROPERTY_TEST(name, Type, value, ...) \
+    __REGISTER_NAMED_TEST_FUNCTIONS(#name, \
+        []() \
+        { \
+            static const TestRunner::Assertion slimTestAssertion = \
+                { __FILE_NAME, __LINE_NUMBER, #name, "the property to hold for every " #Type }; \
+            TestRunner::checkProperty<Type>(slimTestAssertion, [](const Type& value) \
+            { \
+                __VA_ARGS__ \
+            }); \
+        } \
+    )
+
+#ifdef DEFINE_PARAMETERIZED_TEST
+    #undef DEFINE_PARAMETERIZED_TEST
+#endif
+#define DEFINE_PARAMETERIZED_TEST(name, Type, value, values, ...) \
+    __REGISTER_NAMED_TEST_FUNCTIONS(#name, \
+        []() \
+        { \
+            static const TestRunner::Assertion slimTestAssertion = \
+                { __FILE_NAME, __LINE_NUMBER, #name, "the property to hold for every " #Type " in " #values }; \
+            TestRunner::checkParameters<Type>(slimTestAssertion, values, [](const Type& value) \
+            { \
+                __VA_ARGS__ \
+            }); \
+        } \
+    )
+
+#ifdef DEFINE_STRESS_TEST
+    #undef DEFINE_STRESS_TEST
+#endif
+#define DEFINE_STRESS_TEST(name, threads, iterations, thread, ...) \
+    __REGISTER_NAMED_TEST_FUNCTIONS(#name, \
+        []() \
+        { \
+            static const TestRunner::Assertion slimTestAssertion = \
+                { __FILE_NAME, __LINE_NUMBER, #name, "every thread to pass every iteration" }; \
+            TestRunner::checkStress(slimTestAssertion, (threads), (iterations), [](size_t thread) \
+            { \
+                (void)thread; \
+                __VA_ARGS__ \
+            }); \
+        } \
+    )
+
+#ifdef DEFINE_FUZZ_TEST
+    #undef DEFINE_FUZZ_TEST
+#endif
+#define DEFINE_FUZZ_TEST(name, data, size, ...) \
+    __REGISTER_NAMED_TEST_FUNCTIONS(#name, \
+        []() \
+        { \
+            static const TestRunner::Assertion slimTestAssertion = \
+                { __FILE_NAME, __LINE_NUMBER, #name, "every input to pass" }; \
+            TestRunner::checkFuzzTarget(slimTestAssertion, #name, [](const std::uint8_t* data, size_t size) \
+            { \
+                (void)data; \
+                (void)size; \
+                __VA_ARGS__ \
+            }); \
+        } \
+    )
+
+#ifdef __MOCK_MEMBER
+    #undef __MOCK_MEMBER
+#endif
+#define __MOCK_MEMBER(name, ...) \
+    using slimTestSignature_ ## name = __VA_ARGS__; \
+    static const TestRunner::Assertion& slimTestUnexpected_ ## name() \
+    { \
+        static const TestRunner::Assertion slimTestAssertion = \
+            { __FILE_NAME, __LINE_NUMBER, #name, "every call to match an expectation" }; \
+        return slimTestAssertion; \
+    } \
+    mutable SlimTest::Mock<slimTestSignature_ ## name> name ## Mock{ slimTestUnexpected_ ## name() };
+
+#ifdef __MOCK_RESULT
+    #undef __MOCK_RESULT
+#endif
+#define __MOCK_RESULT(name) \
+    typename SlimTest::MockSignature<slimTestSignature_ ## name>::Returned
+
+#ifdef __MOCK_ARGUMENT
+    #undef __MOCK_ARGUMENT
+#endif
+#define __MOCK_ARGUMENT(name, index) \
+    typename SlimTest::MockSignature<slimTestSignature_ ## name>::template Argument<index>::Type
+
+#ifdef MOCK_METHOD0
+    #undef MOCK_METHOD0
+#endif
+#define MOCK_METHOD0(name, ...) \
+    __MOCK_METHOD0(name, , __VA_ARGS__)
+
+#ifdef MOCK_CONST_METHOD0
+    #undef MOCK_CONST_METHOD0
+#endif
+#define MOCK_CONST_METHOD0(name, ...) \
+    __MOCK_METHOD0(name, const, __VA_ARGS__)
+
+#ifdef __MOCK_METHOD0
+    #undef __MOCK_METHOD0
+#endif
+#define __MOCK_METHOD0(name, constness, ...) \
+    __MOCK_MEMBER(name, __VA_ARGS__) \
+    __MOCK_RESULT(name) name() constness \
+    { \
+        return name ## Mock(); \
+    }
+
+#ifdef MOCK_METHOD1
+    #undef MOCK_METHOD1
+#endif
+#define MOCK_METHOD1(name, ...) \
+    __MOCK_METHOD1(name, , __VA_ARGS__)
+
+#ifdef MOCK_CONST_METHOD1
+    #undef MOCK_CONST_METHOD1
+#endif
+#define MOCK_CONST_METHOD1(name, ...) \
+    __MOCK_METHOD1(name, const, __VA_ARGS__)
+
+#ifdef __MOCK_METHOD1
+    #undef __MOCK_METHOD1
+#endif
+#define __MOCK_METHOD1(name, constness, ...) \
+    __MOCK_MEMBER(name, __VA_ARGS__) \
+    __MOCK_RESULT(name) name(__MOCK_ARGUMENT(name, 0) slimTest0) constness \
+    { \
+        return name ## Mock(slimTest0); \
+    }
+
+#ifdef MOCK_METHOD2
+    #undef MOCK_METHOD2
+#endif
+#define MOCK_METHOD2(name, ...) \
+    __MOCK_METHOD2(name, , __VA_ARGS__)
+
+#ifdef MOCK_CONST_METHOD2
+    #undef MOCK_CONST_METHOD2
+#endif
+#define MOCK_CONST_METHOD2(name, ...) \
+    __MOCK_METHOD2(name, const, __VA_ARGS__)
+
+#ifdef __MOCK_METHOD2
+    #undef __MOCK_METHOD2
+#endif
+#define __MOCK_METHOD2(name, constness, ...) \
+    __MOCK_MEMBER(name, __VA_ARGS__) \
+    __MOCK_RESULT(name) name(__MOCK_ARGUMENT(name, 0) slimTest0, __MOCK_ARGUMENT(name, 1) slimTest1) constness \
+    { \
+        return name ## Mock(slimTest0, slimTest1); \
+    }
+
+#ifdef MOCK_METHOD3
+    #undef MOCK_METHOD3
+#endif
+#define MOCK_METHOD3(name, ...) \
+    __MOCK_METHOD3(name, , __VA_ARGS__)
+
+#ifdef MOCK_CONST_METHOD3
+    #undef MOCK_CONST_METHOD3
+#endif
+#define MOCK_CONST_METHOD3(name, ...) \
+    __MOCK_METHOD3(name, const, __VA_ARGS__)
+
+#ifdef __MOCK_METHOD3
+    #undef __MOCK_METHOD3
+#endif
+#define __MOCK_METHOD3(name, constness, ...) \
+    __MOCK_MEMBER(name, __VA_ARGS__) \
+    __MOCK_RESULT(name) name(__MOCK_ARGUMENT(name, 0) slimTest0, __MOCK_ARGUMENT(name, 1) slimTest1, __MOCK_ARGUMENT(name, 2) slimTest2) constness \
+    { \
+        return name ## Mock(slimTest0, slimTest1, slimTest2); \
+    }
+
+#ifdef MOCK_METHOD4
+    #undef MOCK_METHOD4
+#endif
+#define MOCK_METHOD4(name, ...) \
+    __MOCK_METHOD4(name, , __VA_ARGS__)
+
+#ifdef MOCK_CONST_METHOD4
+    #undef MOCK_CONST_METHOD4
+#endif
+#define MOCK_CONST_METHOD4(name, ...) \
+    __MOCK_METHOD4(name, const, __VA_ARGS__)
+
+#ifdef __MOCK_METHOD4
+    #undef __MOCK_METHOD4
+#endif
+#define __MOCK_METHOD4(name, constness, ...) \
+    __MOCK_MEMBER(name, __VA_ARGS__) \
+    __MOCK_RESULT(name) name(__MOCK_ARGUMENT(name, 0) slimTest0, __MOCK_ARGUMENT(name, 1) slimTest1, __MOCK_ARGUMENT(name, 2) slimTest2, __MOCK_ARGUMENT(name, 3) slimTest3) constness \
+    { \
+        return name ## Mock(slimTest0, slimTest1, slimTest2, slimTest3); \
+    }
+
+#ifdef BENCHMARK_LOOP
+    #undef BENCHMARK_LOOP
+#endif
+#define BENCHMARK_LOOP \
+    for(size_t slimTestIteration = 0; slimTestIteration < slimTestIterations; ++slimTestIteration)
+
 #ifdef __EXPANDED_LINE_NUMBER
     #undef __EXPANDED_LINE_NUMBER
 #endif
 #define __EXPANDED_LINE_NUMBER(x) \
-    __zz_ ## x
+    __zz_ ## x ## _zzStaticTestRunner
 
 #ifdef ___EXPANDED_LINE_NUMBER
     #undef ___EXPANDED_LINE_NUMBER
@@ -286,18 +6371,125 @@ inline TestRunner& TestRunner::testRunner()
 #define ___EXPANDED_LINE_NUMBER(x) \
     __EXPANDED_LINE_NUMBER(x)
 
+#ifdef __EXPANDED_FUNCTIONS
+    #undef __EXPANDED_FUNCTIONS
+#endif
+#define __EXPANDED_FUNCTIONS(x) \
+    __zz_ ## x ## _zzStaticTestFunctions
+
+#ifdef ___EXPANDED_FUNCTIONS
+    #undef ___EXPANDED_FUNCTIONS
+#endif
+#define ___EXPANDED_FUNCTIONS(x) \
+    __EXPANDED_FUNCTIONS(x)
+
 #ifdef REGISTER_TEST_FUNCTIONS
     #undef REGISTER_TEST_FUNCTIONS
 #endif
 #define REGISTER_TEST_FUNCTIONS(...) \
-        static const TestRunner ___EXPANDED_LINE_NUMBER(__LINE__) ## _zzStaticTestRunner \
-            = TestRunner({__VA_ARGS__});
+    __REGISTER_NAMED_TEST_FUNCTIONS(#__VA_ARGS__, __VA_ARGS__)
+
+#ifdef __REGISTER_NAMED_TEST_FUNCTIONS
+    #undef __REGISTER_NAMED_TEST_FUNCTIONS
+#endif
+#define __REGISTER_NAMED_TEST_FUNCTIONS(names, ...) \
+    __REGISTER_FIXTURE_TEST_FUNCTIONS(names, nullptr, __VA_ARGS__)
+
+#ifdef __REGISTER_FIXTURE_TEST_FUNCTIONS
+    #undef __REGISTER_FIXTURE_TEST_FUNCTIONS
+#endif
+#define __REGISTER_FIXTURE_TEST_FUNCTIONS(names, fixture, ...) \
+        static void (* const ___EXPANDED_FUNCTIONS(__LINE__)[])() = { __VA_ARGS__ }; \
+        static TestRunner::Registration ___EXPANDED_LINE_NUMBER(__LINE__) \
+            (names, __FILE_NAME, __LINE_NUMBER, ___EXPANDED_FUNCTIONS(__LINE__), \
+            sizeof(___EXPANDED_FUNCTIONS(__LINE__)) / sizeof(*___EXPANDED_FUNCTIONS(__LINE__)), fixture);
+
+#ifdef __SIZED_DEALLOCATION_HOOKS
+    #undef __SIZED_DEALLOCATION_HOOKS
+#endif
+#ifdef __cpp_sized_deallocation
+#define __SIZED_DEALLOCATION_HOOKS \
+    void operator delete(void* memory, size_t) noexcept { TestRunner::deallocate(memory); } \
+    void operator delete[](void* memory, size_t) noexcept { TestRunner::deallocate(memory); }
+#else
+#define __SIZED_DEALLOCATION_HOOKS
+#endif
+
+#ifdef __SIZED_TRACKED_HOOKS
+    #undef __SIZED_TRACKED_HOOKS
+#endif
+#ifdef __cpp_sized_deallocation
+#define __SIZED_TRACKED_HOOKS \
+    SLIMTEST_NOINLINE void operator delete(void* memory, size_t) noexcept \
+        { TestRunner::deallocateTracked(memory, false, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void operator delete[](void* memory, size_t) noexcept \
+        { TestRunner::deallocateTracked(memory, true, SLIMTEST_RETURN_ADDRESS); }
+#else
+#define __SIZED_TRACKED_HOOKS
+#endif
+
+#ifdef __ALLOCATION_HOOKS
+    #undef __ALLOCATION_HOOKS
+#endif
+// Out of line, so the return address is the call site of new and delete. The std::align_val_t
+// forms are left to the library, blocks of over-aligned types are not tracked.
+#if defined SLIMTEST_TRACK_LEAKS
+#define __ALLOCATION_HOOKS \
+    SLIMTEST_NOINLINE void* operator new(size_t size) { return TestRunner::allocateTracked(size, false, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void* operator new[](size_t size) { return TestRunner::allocateTracked(size, true, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void* operator new(size_t size, const std::nothrow_t&) noexcept \
+    { \
+        try { return TestRunner::allocateTracked(size, false, SLIMTEST_RETURN_ADDRESS); } \
+        catch(...) { return nullptr; } \
+    } \
+    SLIMTEST_NOINLINE void* operator new[](size_t size, const std::nothrow_t&) noexcept \
+    { \
+        try { return TestRunner::allocateTracked(size, true, SLIMTEST_RETURN_ADDRESS); } \
+        catch(...) { return nullptr; } \
+    } \
+    SLIMTEST_NOINLINE void operator delete(void* memory) noexcept { TestRunner::deallocateTracked(memory, false, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void operator delete[](void* memory) noexcept { TestRunner::deallocateTracked(memory, true, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void operator delete(void* memory, const std::nothrow_t&) noexcept \
+        { TestRunner::deallocateTracked(memory, false, SLIMTEST_RETURN_ADDRESS); } \
+    SLIMTEST_NOINLINE void operator delete[](void* memory, const std::nothrow_t&) noexcept \
+        { TestRunner::deallocateTracked(memory, true, SLIMTEST_RETURN_ADDRESS); } \
+    __SIZED_TRACKED_HOOKS
+#elif defined SLIMTEST_COUNT_ALLOCATIONS
+#define __ALLOCATION_HOOKS \
+    void* operator new(size_t size) { return TestRunner::allocate(size); } \
+    void* operator new[](size_t size) { return TestRunner::allocate(size); } \
+    void operator delete(void* memory) noexcept { TestRunner::deallocate(memory); } \
+    void operator delete[](void* memory) noexcept { TestRunner::deallocate(memory); } \
+    __SIZED_DEALLOCATION_HOOKS
+#else
+#define __ALLOCATION_HOOKS
+#endif
+
+#ifdef __COVERAGE_HOOKS
+    #undef __COVERAGE_HOOKS
+#endif
+// trace-pc-guard and pc-table as clang emits them, trace-pc as gcc does
+#if defined SLIMTEST_COVERAGE && defined SLIMTEST_HAS_COVERAGE
+#define __COVERAGE_HOOKS \
+    extern "C" SLIMTEST_NO_COVERAGE void __sanitizer_cov_trace_pc_guard_init(std::uint32_t* start, std::uint32_t* stop) \
+        { TestRunner::CoverageMap::initializeGuards(start, stop); } \
+    extern "C" SLIMTEST_NO_COVERAGE SLIMTEST_NOINLINE void __sanitizer_cov_trace_pc_guard(std::uint32_t* guard) \
+        { TestRunner::CoverageMap::reachGuard(guard, (std::uintptr_t)SLIMTEST_RETURN_ADDRESS); } \
+    extern "C" SLIMTEST_NO_COVERAGE void __sanitizer_cov_pcs_init(const std::uintptr_t* begin, const std::uintptr_t* end) \
+        { TestRunner::CoverageMap::addTable(begin, end); } \
+    extern "C" SLIMTEST_NO_COVERAGE SLIMTEST_NOINLINE void __sanitizer_cov_trace_pc() \
+        { TestRunner::CoverageMap::reach((std::uintptr_t)SLIMTEST_RETURN_ADDRESS); }
+#else
+#define __COVERAGE_HOOKS
+#endif
 
 #ifdef RUN_TESTS_MAIN
     #undef RUN_TESTS_MAIN
 #endif
 #define RUN_TESTS_MAIN(name) \
+    __ALLOCATION_HOOKS \
+    __COVERAGE_HOOKS \
     int main(int argc, char* argv[]) \
     { \
-        return TestRunner::runTests(name); \
-    }
\ No newline at end of file
+        return TestRunner::runTests(name, argc, argv); \
+    }